@@ -0,0 +1,321 @@
+#ifndef EM_CHANNEL
+#define EM_CHANNEL
+
+#include "EMPointer.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+// Bounded multi-producer / multi-consumer queue of em::pointer<T>.
+//
+// em::channel<T> is a ring of cells, each with a sequence number (Vyukov's
+// bounded MPMC queue): a push or pop claims a position with one CAS and then
+// hands the cell over with a release store, no lock involved. Pointers are
+// moved in and out, so the reference count and the deleter are never touched.
+// Batch operations claim a whole run of cells with a single CAS.
+//
+// Every operation takes a channel_mode:
+//     try_once  return at once if the channel is full (push) or empty (pop)
+//     spin      retry, pausing and then yielding, until it succeeds
+//     block     sleep on a condition variable until it succeeds
+// spin and block give up only when the channel is closed. Producers and
+// consumers only take the mutex when someone is actually asleep.
+//
+// A push that fails leaves the pointer with the caller. After close(), pushes
+// fail and pops drain what is left, then fail.
+
+namespace em {
+
+    enum class channel_mode : int {
+        try_once,
+        spin,
+        block
+    };
+
+    namespace detail {
+
+        inline void cpu_relax() {
+#if defined(__i386__) || defined(__x86_64__)
+            __builtin_ia32_pause();
+#elif defined(__aarch64__)
+            __asm__ __volatile__("yield");
+#endif
+        }
+
+        // Pauses for the first rounds of a spin loop, then yields the CPU.
+        class spin_wait {
+        private:
+            unsigned rounds = 0;
+
+        public:
+            void operator()() {
+                if (rounds < 64) {
+                    ++rounds;
+                    cpu_relax();
+                }
+                else {
+                    std::this_thread::yield();
+                }
+            }
+        };
+
+    } // namespace detail
+
+    template<typename T>
+    class channel {
+    private:
+        struct cell {
+            std::atomic<std::size_t> sequence;
+            pointer<T> value;
+        };
+
+        static constexpr std::size_t cache_line = 64;
+
+        pointer<cell> cells;
+        std::size_t mask = 0;
+
+        alignas(cache_line) std::atomic<std::size_t> enqueue_pos{ 0 };
+        alignas(cache_line) std::atomic<std::size_t> dequeue_pos{ 0 };
+        alignas(cache_line) std::atomic<bool> closed{ false };
+        std::atomic<int> push_waiters{ 0 };
+        std::atomic<int> pop_waiters{ 0 };
+        std::mutex sleep_lock;
+        std::condition_variable not_full;
+        std::condition_variable not_empty;
+
+        static std::intptr_t distance(std::size_t sequence, std::size_t position) {
+            return static_cast<std::intptr_t>(sequence - position);
+        }
+
+        // Claims up to `count` consecutive free cells; returns how many were filled.
+        std::size_t enqueue(pointer<T>* values, std::size_t count) {
+            if (!cells || count == 0) {
+                return 0;
+            }
+            std::size_t pos = enqueue_pos.load(std::memory_order_relaxed);
+            std::size_t claimed;
+            for (;;) {
+                claimed = 0;
+                while (claimed < count) {
+                    std::size_t seq = cells[(pos + claimed) & mask].sequence.load(std::memory_order_acquire);
+                    if (distance(seq, pos + claimed) != 0) {
+                        break;
+                    }
+                    ++claimed;
+                }
+                if (claimed == 0) {
+                    std::size_t seq = cells[pos & mask].sequence.load(std::memory_order_acquire);
+                    if (distance(seq, pos) < 0) {
+                        return 0; // full
+                    }
+                    pos = enqueue_pos.load(std::memory_order_relaxed);
+                    continue;
+                }
+                if (enqueue_pos.compare_exchange_weak(pos, pos + claimed, std::memory_order_relaxed)) {
+                    break;
+                }
+            }
+            for (std::size_t i = 0; i < claimed; ++i) {
+                cell& c = cells[(pos + i) & mask];
+                c.value = std::move(values[i]);
+                c.sequence.store(pos + i + 1, std::memory_order_release);
+            }
+            return claimed;
+        }
+
+        // Takes up to `count` consecutive full cells; returns how many were moved out.
+        std::size_t dequeue(pointer<T>* out, std::size_t count) {
+            if (!cells || count == 0) {
+                return 0;
+            }
+            std::size_t pos = dequeue_pos.load(std::memory_order_relaxed);
+            std::size_t claimed;
+            for (;;) {
+                claimed = 0;
+                while (claimed < count) {
+                    std::size_t seq = cells[(pos + claimed) & mask].sequence.load(std::memory_order_acquire);
+                    if (distance(seq, pos + claimed + 1) != 0) {
+                        break;
+                    }
+                    ++claimed;
+                }
+                if (claimed == 0) {
+                    std::size_t seq = cells[pos & mask].sequence.load(std::memory_order_acquire);
+                    if (distance(seq, pos + 1) < 0) {
+                        return 0; // empty
+                    }
+                    pos = dequeue_pos.load(std::memory_order_relaxed);
+                    continue;
+                }
+                if (dequeue_pos.compare_exchange_weak(pos, pos + claimed, std::memory_order_relaxed)) {
+                    break;
+                }
+            }
+            for (std::size_t i = 0; i < claimed; ++i) {
+                cell& c = cells[(pos + i) & mask];
+                out[i] = std::move(c.value);
+                c.sequence.store(pos + i + mask + 1, std::memory_order_release);
+            }
+            return claimed;
+        }
+
+        // Called after making progress. Pairs with the fence in sleep(): either the
+        // sleeper sees our progress, or we see the sleeper and wake it.
+        void wake(std::atomic<int>& waiters, std::condition_variable& sleepers) {
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (waiters.load(std::memory_order_relaxed) > 0) {
+                std::lock_guard<std::mutex> guard(sleep_lock);
+                sleepers.notify_all();
+            }
+        }
+
+        // Announces a sleeper, retries `attempt` once more and sleeps only if it still fails.
+        template<typename Attempt>
+        std::size_t sleep(std::atomic<int>& waiters, std::condition_variable& sleepers, Attempt attempt) {
+            std::unique_lock<std::mutex> lock(sleep_lock);
+            waiters.fetch_add(1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            std::size_t done = attempt();
+            if (done == 0 && !closed.load(std::memory_order_relaxed)) {
+                sleepers.wait(lock);
+            }
+            waiters.fetch_sub(1, std::memory_order_relaxed);
+            return done;
+        }
+
+        std::size_t push_some(pointer<T>* values, std::size_t count, channel_mode mode) {
+            detail::spin_wait backoff;
+            for (;;) {
+                if (closed.load(std::memory_order_acquire)) {
+                    return 0;
+                }
+                std::size_t pushed = enqueue(values, count);
+                if (pushed == 0 && mode == channel_mode::block) {
+                    pushed = sleep(push_waiters, not_full, [&] { return enqueue(values, count); });
+                }
+                if (pushed > 0) {
+                    wake(pop_waiters, not_empty);
+                    return pushed;
+                }
+                if (mode == channel_mode::try_once) {
+                    return 0;
+                }
+                if (mode == channel_mode::spin) {
+                    backoff();
+                }
+            }
+        }
+
+        std::size_t pop_some(pointer<T>* out, std::size_t count, channel_mode mode) {
+            detail::spin_wait backoff;
+            for (;;) {
+                // Read `closed` first: if it was set before this attempt found the
+                // ring empty, no later push can succeed.
+                bool was_closed = closed.load(std::memory_order_acquire);
+                std::size_t popped = dequeue(out, count);
+                if (popped == 0 && mode == channel_mode::block && !was_closed) {
+                    popped = sleep(pop_waiters, not_empty, [&] { return dequeue(out, count); });
+                }
+                if (popped > 0) {
+                    wake(push_waiters, not_full);
+                    return popped;
+                }
+                if (mode == channel_mode::try_once || was_closed) {
+                    return 0;
+                }
+                if (mode == channel_mode::spin) {
+                    backoff();
+                }
+            }
+        }
+
+    public:
+        // Capacity is rounded up to a power of two (at least 2). If the ring cannot
+        // be allocated the channel has capacity 0 and every push fails.
+        explicit channel(std::size_t capacity) {
+            std::size_t rounded = 2;
+            while (rounded < capacity) {
+                rounded <<= 1;
+            }
+            cells = pointer<cell>(rounded);
+            if (cells) {
+                mask = rounded - 1;
+                for (std::size_t i = 0; i < rounded; ++i) {
+                    cells[i].sequence.store(i, std::memory_order_relaxed);
+                }
+            }
+        }
+
+        channel(const channel&) = delete;
+        channel& operator=(const channel&) = delete;
+
+        bool push(pointer<T>&& value, channel_mode mode = channel_mode::block) {
+            return push_some(&value, 1, mode) == 1;
+        }
+
+        bool try_push(pointer<T>&& value) {
+            return push(std::move(value), channel_mode::try_once);
+        }
+
+        // False once the channel is closed and drained (or, with try_once, when empty).
+        bool pop(pointer<T>& out, channel_mode mode = channel_mode::block) {
+            return pop_some(&out, 1, mode) == 1;
+        }
+
+        bool try_pop(pointer<T>& out) {
+            return pop(out, channel_mode::try_once);
+        }
+
+        // Pushes values[0..count) in order. Returns how many went in: all of them
+        // unless the channel was closed or the mode is try_once. Values that did
+        // not go in are left untouched.
+        std::size_t push_batch(pointer<T>* values, std::size_t count, channel_mode mode = channel_mode::block) {
+            std::size_t pushed = 0;
+            while (pushed < count) {
+                std::size_t step = push_some(values + pushed, count - pushed, mode);
+                if (step == 0) {
+                    break;
+                }
+                pushed += step;
+            }
+            return pushed;
+        }
+
+        // Pops up to `max` pointers into out[0..). Waits (per mode) until at least
+        // one is ready, then takes the ready run without waiting for more.
+        std::size_t pop_batch(pointer<T>* out, std::size_t max, channel_mode mode = channel_mode::block) {
+            return pop_some(out, max, mode);
+        }
+
+        // Wakes every sleeper; later pushes fail, pops drain what is left. Call it
+        // once the producers are done: a push racing with close() may still land
+        // after a consumer has seen the channel closed and empty.
+        void close() {
+            closed.store(true, std::memory_order_seq_cst);
+            std::lock_guard<std::mutex> guard(sleep_lock);
+            not_full.notify_all();
+            not_empty.notify_all();
+        }
+
+        bool is_closed() const {
+            return closed.load(std::memory_order_acquire);
+        }
+
+        std::size_t capacity() const {
+            return cells ? mask + 1 : 0;
+        }
+
+        // A snapshot; other threads may change it at any moment.
+        std::size_t size_approx() const {
+            std::size_t tail = dequeue_pos.load(std::memory_order_relaxed);
+            std::size_t head = enqueue_pos.load(std::memory_order_relaxed);
+            return head > tail ? head - tail : 0;
+        }
+    };
+
+}
+#endif // !EM_CHANNEL
@@ -0,0 +1,700 @@
+#ifndef EM_COLLECTABLE_POINTER
+#define EM_COLLECTABLE_POINTER
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <new>
+#include <utility>
+#include <vector>
+
+// Reference-counted pointers whose cycles can be reclaimed.
+//
+// em::collectable_pointer<T> counts references like em::pointer. Whenever a
+// count drops without reaching zero, or a pointer to the object is moved, the
+// object is remembered as a possible root of a garbage cycle. The thread's em::cycle_collector later runs trial
+// deletion (Bacon & Rajan) over those roots: it subtracts the references
+// that come from inside the candidate subgraph, and whatever ends up at zero
+// is only reachable from itself and is freed.
+//
+// The collector finds references through em::trace<T>, which the user
+// specialises for every type that holds collectable_pointers:
+//
+//     template<> struct em::trace<Node> {
+//         template<typename Visitor>
+//         static void apply(Node& node, Visitor& visit) {
+//             visit(node.parent);
+//             for (auto& child : node.children) visit(child);
+//         }
+//     };
+//
+// Collection is opt-in and incremental. A round takes every pending root and
+// runs the three phases of the paper (mark gray, scan, collect white) over all
+// of them together, so a subgraph reachable from many roots is walked once.
+// step() advances the round for a fixed time budget and picks up where the
+// last step stopped; the mutator runs between steps. A collectable graph must
+// stay on the thread that built it.
+
+namespace em {
+
+    template<typename T> class collectable_pointer;
+
+    // Default: T holds no collectable_pointers.
+    template<typename T>
+    struct trace {
+        template<typename Visitor>
+        static void apply(T&, Visitor&) {}
+    };
+
+    namespace detail {
+
+        enum class gc_color : unsigned char {
+            black,   // in use (or already destroyed when rc == 0)
+            gray,    // being trial-deleted
+            white,   // garbage candidate
+            purple   // possible cycle root
+        };
+
+        struct gc_box;
+
+        class gc_visitor {
+        private:
+            void (*callback)(gc_box*& child, void* context);
+            void* context;
+
+        public:
+            gc_visitor(void (*cb)(gc_box*&, void*), void* ctx) : callback(cb), context(ctx) {}
+
+            template<typename U>
+            void operator()(collectable_pointer<U>& child) {
+                if (child.box) {
+                    callback(child.box, context);
+                }
+            }
+        };
+
+        struct gc_box {
+            std::size_t rc = 1;
+            gc_color color = gc_color::black;
+            bool buffered = false;
+            std::uint32_t round = 0; // the collector round that last painted it (0 = none)
+
+            virtual ~gc_box() = default;
+            virtual void visit_children(gc_visitor& visitor) = 0;
+            virtual void destroy_value() = 0;
+        };
+
+        template<typename T>
+        struct gc_object final : gc_box {
+            alignas(T) unsigned char storage[sizeof(T)];
+
+            template<typename... Args>
+            explicit gc_object(Args&&... args) {
+                new(storage) T(std::forward<Args>(args)...);
+            }
+
+            T* value() {
+                return reinterpret_cast<T*>(storage);
+            }
+
+            void visit_children(gc_visitor& visitor) override {
+                trace<T>::apply(*value(), visitor);
+            }
+
+            void destroy_value() override {
+                value()->~T();
+            }
+        };
+
+        template<typename F>
+        void for_each_child(gc_box* box, F& f) {
+            gc_visitor visitor([](gc_box*& child, void* ctx) { (*static_cast<F*>(ctx))(child); }, &f);
+            box->visit_children(visitor);
+        }
+
+    } // namespace detail
+
+    class cycle_collector {
+    private:
+        using gc_box = detail::gc_box;
+        using gc_color = detail::gc_color;
+        using clock = std::chrono::steady_clock;
+
+        enum class phase : unsigned char {
+            idle,
+            marking,    // MarkRoots: trial-decrement everything reachable from the roots
+            scanning,   // ScanRoots: blacken whatever is still referenced
+            restoring,  // give the black boxes their counts without the garbage's edges
+            collecting, // CollectRoots: gather what stayed white
+            detaching,  // cut the garbage's edges; from here on the round cannot be undone
+            forgetting, // drop the undo log
+            freeing,    // destroy and delete the garbage
+            settling    // take the round's roots off the buffer
+        };
+
+        // A box as it was before the current round first painted it.
+        struct painted {
+            gc_box* box;
+            std::size_t rc;
+            gc_color color;
+        };
+
+        std::deque<gc_box*> roots;  // oldest first; the first `round_size` belong to the current round
+        std::size_t round_size = 0;
+        std::uint32_t round_id = 0;
+        std::size_t cursor = 0;     // next root, region entry or garbage box of the current phase
+        std::size_t expanded = 0;   // garbage boxes whose children collecting has visited
+        phase state = phase::idle;
+        // Deques grow and drain a chunk at a time, so no single step pays for
+        // copying or freeing a whole round's worth.
+        std::deque<painted> region;
+        std::deque<gc_box*> garbage;
+        std::vector<gc_box*> work;
+        std::vector<gc_box*> black_stack;
+        std::chrono::nanoseconds budget = std::chrono::milliseconds(1);
+        std::size_t auto_threshold = 0;
+        unsigned interrupted = 0;
+        bool collecting = false;
+
+        cycle_collector() = default;
+
+        // Set once the thread's collector is destroyed; trivially destructible, so
+        // still readable during static destruction.
+        static bool& torn_down() {
+            static thread_local bool flag = false;
+            return flag;
+        }
+
+        // The calling thread's collector, or nullptr once it has been destroyed.
+        static cycle_collector* current() {
+            return torn_down() ? nullptr : &local();
+        }
+
+        static void destroy_box(gc_box* box) {
+            try {
+                box->destroy_value();
+            }
+            catch (...) { /* Cannot throw */ }
+            delete box;
+        }
+
+        // The program is about to touch a box a collector round has painted. If that
+        // round is still working out the garbage, counts in its region are trial
+        // values and garbage may still point at live objects, so the round is undone
+        // first; its roots stay buffered for the next one.
+        static void interrupt(gc_box* box) noexcept {
+            cycle_collector* collector = current();
+            if (collector && box->round == collector->round_id &&
+                collector->state != phase::idle && collector->state <= phase::collecting) {
+                collector->abandon();
+            }
+            box->round = 0;
+        }
+
+        void abandon() noexcept {
+            for (const painted& p : region) {
+                p.box->rc = p.rc;
+                p.box->color = p.color;
+                p.box->round = 0;
+            }
+            region.clear();
+            work.clear();
+            black_stack.clear();
+            garbage.clear();
+            expanded = 0;
+            round_size = 0;
+            state = phase::idle;
+            ++interrupted;
+        }
+
+        // Returns true if the box was not buffered before.
+        bool buffer(gc_box* box) noexcept {
+            if (box->color == gc_color::purple) return false;
+            if (!box->buffered) {
+                try {
+                    roots.push_back(box);
+                }
+                catch (...) { return false; }
+                box->buffered = true;
+                box->color = gc_color::purple;
+                return true;
+            }
+            box->color = gc_color::purple;
+            return false;
+        }
+
+        void possible_root(gc_box* box) {
+            if (buffer(box)) {
+                auto_step();
+            }
+        }
+
+        void auto_step() {
+            if (auto_threshold && roots.size() >= auto_threshold && !collecting) {
+                step();
+            }
+        }
+
+        // The count reached zero: destroy now, keep the header while it is still buffered.
+        // No collection may run inside the destructor (it could free this very box),
+        // so an automatic step is held back until the outermost release returns.
+        void release_box(gc_box* box) {
+            const bool was_collecting = collecting;
+            collecting = true;
+            box->color = gc_color::black;
+            try {
+                box->destroy_value();
+            }
+            catch (...) { /* Cannot throw */ }
+            collecting = was_collecting;
+            if (!box->buffered) {
+                delete box;
+            }
+            auto_step();
+        }
+
+        void paint_gray(gc_box* box) {
+            region.push_back({ box, box->rc, box->color });
+            box->round = round_id;
+            box->color = gc_color::gray;
+            work.push_back(box);
+        }
+
+        // One unit of marking. Roots the round reaches from an earlier root are
+        // already gray and cost nothing more.
+        void mark_one() {
+            if (!work.empty()) {
+                gc_box* box = work.back();
+                work.pop_back();
+                auto visit = [this](gc_box*& child) {
+                    if (child->color != gc_color::gray) {
+                        paint_gray(child);
+                    }
+                    --child->rc;
+                };
+                detail::for_each_child(box, visit);
+            }
+            else if (cursor < round_size) {
+                gc_box* box = roots[cursor++];
+                if (box->color == gc_color::purple && box->rc > 0) {
+                    paint_gray(box);
+                }
+            }
+            else {
+                cursor = 0;
+                state = phase::scanning;
+            }
+        }
+
+        // One unit of scanning; a pending scan_black runs before the scan resumes.
+        // scan_black only paints: the counts come back from the region log, since
+        // nothing else may change them while the round can still be undone. An edge
+        // the program added to an already marked box leads out of the region (it
+        // was never subtracted) and is not followed.
+        void scan_one() {
+            if (!black_stack.empty()) {
+                gc_box* box = black_stack.back();
+                black_stack.pop_back();
+                auto visit = [this](gc_box*& child) {
+                    if (child->round == round_id && child->color != gc_color::black) {
+                        child->color = gc_color::black;
+                        black_stack.push_back(child);
+                    }
+                };
+                detail::for_each_child(box, visit);
+            }
+            else if (!work.empty()) {
+                gc_box* box = work.back();
+                work.pop_back();
+                if (box->color != gc_color::gray) return;
+                if (box->rc > 0) {
+                    box->color = gc_color::black;
+                    black_stack.push_back(box);
+                }
+                else {
+                    box->color = gc_color::white;
+                    auto visit = [this](gc_box*& child) { work.push_back(child); };
+                    detail::for_each_child(box, visit);
+                }
+            }
+            else if (cursor < round_size) {
+                work.push_back(roots[cursor++]);
+            }
+            else {
+                cursor = 0;
+                state = phase::restoring;
+            }
+        }
+
+        // First every black box gets its count from before the round, then the
+        // edges from white boxes, which are about to be detached, are taken off.
+        // The program cannot reach a white box without undoing the round, so its
+        // edges are still the ones marking subtracted.
+        void restore_one() {
+            if (cursor < region.size()) {
+                const painted& p = region[cursor++];
+                if (p.box->color == gc_color::black) {
+                    p.box->rc = p.rc;
+                }
+            }
+            else if (cursor < 2 * region.size()) {
+                gc_box* box = region[cursor++ - region.size()].box;
+                if (box->color == gc_color::white) {
+                    auto visit = [this](gc_box*& child) {
+                        if (child->round == round_id && child->color == gc_color::black) {
+                            --child->rc;
+                        }
+                    };
+                    detail::for_each_child(box, visit);
+                }
+            }
+            else {
+                cursor = 0;
+                state = phase::collecting;
+            }
+        }
+
+        void collect_one() {
+            if (expanded < garbage.size()) {
+                auto visit = [this](gc_box*& child) {
+                    if (child->color == gc_color::white) {
+                        child->color = gc_color::black;
+                        garbage.push_back(child);
+                    }
+                };
+                detail::for_each_child(garbage[expanded++], visit);
+            }
+            else if (cursor < round_size) {
+                gc_box* box = roots[cursor++];
+                if (box->color == gc_color::white) {
+                    box->color = gc_color::black;
+                    garbage.push_back(box);
+                }
+            }
+            else {
+                cursor = 0;
+                expanded = 0;
+                interrupted = 0;
+                state = phase::detaching;
+            }
+        }
+
+        // Every edge out of a garbage object was already subtracted by marking,
+        // so detach them before the destructors run instead of releasing them.
+        void detach_one() {
+            if (cursor < garbage.size()) {
+                gc_box* box = garbage[cursor++];
+                auto detach = [](gc_box*& child) { child = nullptr; };
+                detail::for_each_child(box, detach);
+                box->rc = 0;
+            }
+            else {
+                cursor = 0;
+                state = phase::forgetting;
+            }
+        }
+
+        // Boxes keep their round tag; the next touch clears it.
+        void forget_one() {
+            if (!region.empty()) {
+                region.pop_front();
+            }
+            else {
+                state = phase::freeing;
+            }
+        }
+
+        // Garbage that is still buffered keeps its header until it leaves the buffer.
+        void free_one() {
+            if (!garbage.empty()) {
+                gc_box* box = garbage.front();
+                garbage.pop_front();
+                try {
+                    box->destroy_value();
+                }
+                catch (...) { /* Cannot throw */ }
+                if (!box->buffered) {
+                    delete box;
+                }
+            }
+            else {
+                state = phase::settling;
+            }
+        }
+
+        void settle_one() {
+            if (round_size > 0) {
+                gc_box* box = roots.front();
+                roots.pop_front();
+                --round_size;
+                if (box->rc == 0) {
+                    delete box; // collected, or released while the round ran
+                }
+                else if (box->color == gc_color::purple) {
+                    roots.push_back(box); // released again while the round ran; still buffered
+                }
+                else {
+                    box->buffered = false;
+                }
+            }
+            else {
+                state = phase::idle;
+            }
+        }
+
+        // Works through rounds until the buffer is empty or `deadline` (if any)
+        // passes. Returns true when the buffer is empty.
+        bool run(const clock::time_point* deadline) {
+            std::size_t until_check = 256;
+            for (;;) {
+                if (state == phase::idle) {
+                    if (roots.empty()) return true;
+                    round_size = roots.size();
+                    round_id = round_id + 1 ? round_id + 1 : 1;
+                    cursor = 0;
+                    state = phase::marking;
+                }
+                // A round the program keeps interrupting is marked and scanned in one go.
+                const bool bounded = deadline && (interrupted < 2 || state > phase::collecting);
+                if (bounded && --until_check == 0) {
+                    until_check = 256;
+                    if (clock::now() >= *deadline) return false;
+                }
+                switch (state) {
+                case phase::marking: mark_one(); break;
+                case phase::scanning: scan_one(); break;
+                case phase::restoring: restore_one(); break;
+                case phase::collecting: collect_one(); break;
+                case phase::detaching: detach_one(); break;
+                case phase::forgetting: forget_one(); break;
+                case phase::freeing: free_one(); break;
+                case phase::settling: settle_one(); break;
+                case phase::idle: break;
+                }
+            }
+        }
+
+        template <typename U> friend class collectable_pointer;
+
+    public:
+        cycle_collector(const cycle_collector&) = delete;
+        cycle_collector& operator=(const cycle_collector&) = delete;
+
+        // Collects what is left. collectable_pointers released later on this thread
+        // (e.g. statics) still free objects whose count reaches zero, but cycles
+        // among them are no longer reclaimed.
+        ~cycle_collector() {
+            collect();
+            torn_down() = true;
+        }
+
+        // The collector of the calling thread.
+        static cycle_collector& local() {
+            static thread_local cycle_collector instance;
+            return instance;
+        }
+
+        // Time a single step() may take, checked every few hundred objects.
+        // A step overruns it by at most one object's visit or destructor, unless
+        // the program interrupted the current round twice already (see step()).
+        void set_step_budget(std::chrono::nanoseconds step_budget) {
+            budget = step_budget;
+        }
+
+        // Run step() automatically once this many roots are pending (0 = never).
+        void set_auto_collect_threshold(std::size_t pending) {
+            auto_threshold = pending;
+        }
+
+        std::size_t pending_roots() const {
+            return roots.size();
+        }
+
+        // Continues the collection for at most the step budget. A round takes every
+        // root pending when it starts and may span many steps. If the program copies,
+        // moves or releases a pointer into the round's subgraph before the round has
+        // found its garbage, the round is undone and starts again; the third attempt
+        // gets that far without a budget. Returns true while work remains.
+        bool step() {
+            if (collecting) return state != phase::idle || !roots.empty();
+            collecting = true;
+            const clock::time_point deadline = clock::now() + budget;
+            const bool done = run(&deadline);
+            collecting = false;
+            return !done;
+        }
+
+        // Finishes the round in progress and processes every pending root, ignoring the budget.
+        void collect() {
+            if (collecting) return;
+            collecting = true;
+            run(nullptr);
+            collecting = false;
+        }
+    };
+
+    template<typename T>
+    class collectable_pointer {
+    private:
+        detail::gc_box* box = nullptr;
+
+        explicit collectable_pointer(detail::gc_box* adopted) : box(adopted) {}
+
+        detail::gc_object<T>* object() const {
+            return static_cast<detail::gc_object<T>*>(box);
+        }
+
+        // Every operation that reads or changes a count, or moves an edge, comes
+        // through here first.
+        void touch() const noexcept {
+            if (box && box->round) {
+                cycle_collector::interrupt(box);
+            }
+        }
+
+        void release() {
+            touch();
+            detail::gc_box* old = box;
+            box = nullptr;
+            if (!old) return;
+            cycle_collector* collector = cycle_collector::current();
+            if (--old->rc == 0) {
+                if (collector) {
+                    collector->release_box(old);
+                }
+                else {
+                    cycle_collector::destroy_box(old);
+                }
+            }
+            else if (collector) {
+                collector->possible_root(old);
+            }
+        }
+
+        // A move can hand an object's last outside reference to one of its own
+        // cycle without any count dropping, so the object is remembered as a
+        // possible root just as a release would.
+        static void moved(detail::gc_box* moved_box) noexcept {
+            if (moved_box && moved_box->color != detail::gc_color::purple) {
+                cycle_collector* collector = cycle_collector::current();
+                if (collector) {
+                    collector->buffer(moved_box);
+                }
+            }
+        }
+
+        friend class detail::gc_visitor;
+        template <typename U, typename... Args> friend collectable_pointer<U> make_collectable(Args&&... args);
+
+    public:
+        using value_type = T;
+
+        collectable_pointer() = default;
+        collectable_pointer(std::nullptr_t) {}
+
+        collectable_pointer(const collectable_pointer& other) : box(other.box) {
+            touch();
+            if (box) {
+                ++box->rc;
+                box->color = detail::gc_color::black;
+            }
+        }
+
+        collectable_pointer(collectable_pointer&& other) noexcept : box(other.box) {
+            touch();
+            moved(box);
+            other.box = nullptr;
+        }
+
+        ~collectable_pointer() {
+            release();
+        }
+
+        collectable_pointer& operator=(const collectable_pointer& other) {
+            if (this != &other) {
+                collectable_pointer temp(other);
+                std::swap(box, temp.box);
+            }
+            return *this;
+        }
+
+        collectable_pointer& operator=(collectable_pointer&& other) noexcept {
+            if (this != &other) {
+                collectable_pointer temp(std::move(other));
+                std::swap(box, temp.box);
+            }
+            return *this;
+        }
+
+        collectable_pointer& operator=(std::nullptr_t) {
+            release();
+            return *this;
+        }
+
+        T& operator*() const {
+            return *object()->value();
+        }
+
+        T* operator->() const {
+            return box ? object()->value() : nullptr;
+        }
+
+        T* get_raw_ptr() const {
+            return box ? object()->value() : nullptr;
+        }
+
+        explicit operator bool() const {
+            return box != nullptr;
+        }
+
+        bool is_null() const {
+            return box == nullptr;
+        }
+
+        int use_count() const {
+            touch();
+            return box ? static_cast<int>(box->rc) : 0;
+        }
+
+        void swap(collectable_pointer& other) noexcept {
+            touch();
+            other.touch();
+            moved(box);
+            moved(other.box);
+            std::swap(box, other.box);
+        }
+    };
+
+    template<typename T, typename... Args>
+    collectable_pointer<T> make_collectable(Args&&... args) {
+        return collectable_pointer<T>(new detail::gc_object<T>(std::forward<Args>(args)...));
+    }
+
+    template<typename T>
+    void swap(collectable_pointer<T>& lhs, collectable_pointer<T>& rhs) noexcept {
+        lhs.swap(rhs);
+    }
+
+    template<typename T, typename U>
+    bool operator==(const collectable_pointer<T>& lhs, const collectable_pointer<U>& rhs) {
+        return lhs.get_raw_ptr() == rhs.get_raw_ptr();
+    }
+
+    template<typename T, typename U>
+    bool operator!=(const collectable_pointer<T>& lhs, const collectable_pointer<U>& rhs) {
+        return !(lhs == rhs);
+    }
+
+    template<typename T>
+    bool operator==(const collectable_pointer<T>& lhs, std::nullptr_t) {
+        return lhs.is_null();
+    }
+
+    template<typename T>
+    bool operator!=(const collectable_pointer<T>& lhs, std::nullptr_t) {
+        return !lhs.is_null();
+    }
+
+}
+#endif // !EM_COLLECTABLE_POINTER
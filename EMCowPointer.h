@@ -0,0 +1,113 @@
+#ifndef EM_COW_POINTER
+#define EM_COW_POINTER
+
+#include "EMPointer.h"
+#include <cstddef>
+#include <new>
+#include <utility>
+
+// Copy-on-write handle over em::pointer's shared count.
+//
+// Reads never copy. write() deep-copies the object only while the snapshot is
+// shared (use_count() > 1) or not owned at all (a borrow() view, use_count()
+// == 0); afterwards the handle is the unique owner and later writes go
+// straight to the object. Different cow_pointer objects may be used
+// from different threads; a single cow_pointer object is not synchronised.
+
+namespace em {
+
+    template<typename T>
+    class cow_pointer {
+        static_assert(!std::is_void<T>::value, "cow_pointer needs a copyable object type");
+
+    private:
+        pointer<T> shared;
+
+    public:
+        using value_type = T;
+
+        cow_pointer() = default;
+        cow_pointer(std::nullptr_t) {}
+
+        explicit cow_pointer(T* val) : shared(val) {}
+
+        explicit cow_pointer(pointer<T> val) : shared(std::move(val)) {}
+
+        cow_pointer(const cow_pointer& other) = default;
+        cow_pointer(cow_pointer&& other) noexcept = default;
+        cow_pointer& operator=(const cow_pointer& other) = default;
+        cow_pointer& operator=(cow_pointer&& other) noexcept = default;
+
+        cow_pointer& operator=(std::nullptr_t) {
+            shared = nullptr;
+            return *this;
+        }
+
+        const T& operator*() const {
+            return *shared;
+        }
+
+        const T* operator->() const {
+            return shared.get_raw_ptr();
+        }
+
+        const T* get_raw_ptr() const {
+            return shared.get_raw_ptr();
+        }
+
+        // Mutable access. Copies the object first unless this handle is its sole
+        // owner. Throws std::bad_alloc rather than hand out a shared object.
+        T& write() {
+            if (shared && shared.use_count() != 1) {
+                pointer<T> copy(new T(*shared));
+                if (!copy) {
+                    throw std::bad_alloc();
+                }
+                shared = std::move(copy);
+            }
+            return *shared;
+        }
+
+        explicit operator bool() const {
+            return static_cast<bool>(shared);
+        }
+
+        bool is_null() const {
+            return shared.is_null();
+        }
+
+        bool is_unique() const {
+            return shared.use_count() == 1;
+        }
+
+        int use_count() const {
+            return shared.use_count();
+        }
+
+        void swap(cow_pointer& other) noexcept {
+            shared.swap(other.shared);
+        }
+    };
+
+    template<typename T>
+    void swap(cow_pointer<T>& lhs, cow_pointer<T>& rhs) noexcept {
+        lhs.swap(rhs);
+    }
+
+    template<typename T, typename... Args>
+    cow_pointer<T> make_cow(Args&&... args) {
+        return cow_pointer<T>(new T(std::forward<Args>(args)...));
+    }
+
+    template<typename T, typename U>
+    bool operator==(const cow_pointer<T>& lhs, const cow_pointer<U>& rhs) {
+        return lhs.get_raw_ptr() == rhs.get_raw_ptr();
+    }
+
+    template<typename T, typename U>
+    bool operator!=(const cow_pointer<T>& lhs, const cow_pointer<U>& rhs) {
+        return !(lhs == rhs);
+    }
+
+}
+#endif // !EM_COW_POINTER
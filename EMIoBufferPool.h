@@ -0,0 +1,270 @@
+#ifndef EM_IO_BUFFER_POOL
+#define EM_IO_BUFFER_POOL
+
+#include "EMPointer.h"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <utility>
+#include <vector>
+
+#if !defined(__unix__) && !defined(__APPLE__)
+#error "EMIoBufferPool.h requires POSIX (posix_memalign/mlock/pread)"
+#endif
+
+#include <sys/mman.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+// Recycled, aligned buffers for direct I/O.
+//
+// em::io_buffer_pool allocates every buffer up front, in a few fixed size
+// classes, aligned for O_DIRECT (page size by default) and optionally locked
+// in RAM. acquire(bytes) hands out a buffer of the smallest class that fits as
+// an ordinary em::pointer<unsigned char>; when its last copy goes away the
+// buffer returns to the pool instead of being freed. Buffers may outlive the
+// pool object itself: the pool's memory is released with its last buffer.
+//
+// em::pread / em::pwrite read and write straight into pooled buffers.
+// tools/io_pool_bench.cpp compares pooled O_DIRECT with buffered I/O.
+//
+//     auto pool = em::io_buffer_pool::create({ { 4096, 64 }, { 1 << 20, 8 } });
+//     em::pointer<unsigned char> block = pool.acquire(4096);
+//     ssize_t got = em::pread(fd, block, 4096, offset);
+
+namespace em {
+
+    namespace detail {
+
+        struct io_pool_state;
+
+        // One per buffer, built with the pool. `block` is the first member, so
+        // dispose() can get from the block back to the slot.
+        struct io_pool_slot {
+            ref_block block{ 0, &dispose };
+            io_pool_state* pool = nullptr;
+            std::size_t index = 0;
+            unsigned char* buffer = nullptr;
+
+            static void dispose(ref_block* released);
+        };
+
+        struct io_pool_class {
+            std::size_t buffer_size;
+            std::size_t count;
+            unsigned char* region;
+            std::unique_ptr<io_pool_slot[]> slots;
+            std::vector<io_pool_slot*> free_slots;
+        };
+
+        // Owned jointly by the io_buffer_pool handles (one reference between them)
+        // and by every buffer handed out; the last of them deletes it.
+        struct io_pool_state {
+            std::mutex lock;
+            std::vector<io_pool_class> classes;
+            std::atomic<std::size_t> users{ 1 };
+            bool locked = false;
+
+            ~io_pool_state() {
+                for (io_pool_class& c : classes) {
+                    if (locked) {
+                        ::munlock(c.region, c.buffer_size * c.count);
+                    }
+                    std::free(c.region);
+                }
+            }
+
+            void drop() {
+                if (users.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                    delete this;
+                }
+            }
+        };
+
+        inline void io_pool_slot::dispose(ref_block* released) {
+            io_pool_slot* slot = reinterpret_cast<io_pool_slot*>(released);
+            io_pool_state* owner = slot->pool;
+            {
+                std::lock_guard<std::mutex> guard(owner->lock);
+                // Reserved to the class's buffer count, so this never allocates.
+                owner->classes[slot->index].free_slots.push_back(slot);
+            }
+            owner->drop();
+        }
+
+    } // namespace detail
+
+    class io_buffer_pool {
+    public:
+        struct size_class {
+            std::size_t buffer_size;
+            std::size_t count;
+        };
+
+    private:
+        pointer<detail::io_pool_state> state;
+
+    public:
+        io_buffer_pool() = default;
+
+        // Sizes are rounded up to a multiple of `alignment` (0 = the page size).
+        // With lock_memory every buffer is mlock()ed. Returns an invalid pool if
+        // the alignment is not a power of two, or allocating or locking fails.
+        static io_buffer_pool create(const std::vector<size_class>& classes, std::size_t alignment = 0, bool lock_memory = false) {
+            if (alignment == 0) {
+                long page = ::sysconf(_SC_PAGESIZE);
+                alignment = page > 0 ? static_cast<std::size_t>(page) : 4096;
+            }
+            if ((alignment & (alignment - 1)) != 0 || alignment < sizeof(void*)) {
+                return io_buffer_pool();
+            }
+
+            detail::io_pool_state* built = new(std::nothrow) detail::io_pool_state;
+            if (!built) {
+                return io_buffer_pool();
+            }
+            built->locked = lock_memory;
+            try {
+                built->classes.reserve(classes.size());
+                for (const size_class& requested : classes) {
+                    if (requested.buffer_size == 0 || requested.count == 0) {
+                        continue;
+                    }
+                    detail::io_pool_class c;
+                    c.buffer_size = (requested.buffer_size + alignment - 1) / alignment * alignment;
+                    c.count = requested.count;
+                    c.region = nullptr;
+                    c.slots.reset(new detail::io_pool_slot[c.count]);
+                    c.free_slots.reserve(c.count);
+
+                    void* region = nullptr;
+                    if (c.buffer_size > static_cast<std::size_t>(-1) / c.count ||
+                        ::posix_memalign(&region, alignment, c.buffer_size * c.count) != 0) {
+                        delete built;
+                        return io_buffer_pool();
+                    }
+                    c.region = static_cast<unsigned char*>(region);
+                    if (lock_memory && ::mlock(c.region, c.buffer_size * c.count) != 0) {
+                        std::free(c.region);
+                        delete built;
+                        return io_buffer_pool();
+                    }
+                    for (std::size_t i = 0; i < c.count; ++i) {
+                        c.slots[i].pool = built;
+                        c.slots[i].buffer = c.region + i * c.buffer_size;
+                    }
+                    // Pushed in reverse so the first acquires walk the region forwards.
+                    for (std::size_t i = c.count; i > 0; --i) {
+                        c.free_slots.push_back(&c.slots[i - 1]);
+                    }
+                    built->classes.push_back(std::move(c));
+                }
+            }
+            catch (...) {
+                delete built;
+                return io_buffer_pool();
+            }
+            // Smallest class first, so acquire() can stop at the first fit.
+            std::sort(built->classes.begin(), built->classes.end(),
+                [](const detail::io_pool_class& a, const detail::io_pool_class& b) { return a.buffer_size < b.buffer_size; });
+            for (std::size_t index = 0; index < built->classes.size(); ++index) {
+                detail::io_pool_class& c = built->classes[index];
+                for (std::size_t i = 0; i < c.count; ++i) {
+                    c.slots[i].index = index;
+                }
+            }
+
+            io_buffer_pool pool;
+            pool.state = pointer<detail::io_pool_state>(built, [](detail::io_pool_state* released) {
+                released->drop();
+            });
+            return pool;
+        }
+
+        explicit operator bool() const {
+            return !state.is_null();
+        }
+
+        // A free buffer of at least `bytes` from the smallest class that has one,
+        // or null if none is free. The buffer's contents are not cleared. Neither
+        // this nor the buffer's release allocates: each buffer has its own count.
+        pointer<unsigned char> acquire(std::size_t bytes) {
+            if (!state) {
+                return pointer<unsigned char>();
+            }
+            detail::io_pool_slot* slot = nullptr;
+            {
+                std::lock_guard<std::mutex> guard(state->lock);
+                for (detail::io_pool_class& c : state->classes) {
+                    if (c.buffer_size >= bytes && !c.free_slots.empty()) {
+                        slot = c.free_slots.back();
+                        c.free_slots.pop_back();
+                        break;
+                    }
+                }
+            }
+            if (!slot) {
+                return pointer<unsigned char>();
+            }
+            state->users.fetch_add(1, std::memory_order_relaxed);
+            slot->block.count.store(1, std::memory_order_relaxed);
+            return detail::pointer_access::adopt(&slot->block, slot->buffer);
+        }
+
+        // Size of the buffer acquire(bytes) hands out, or 0 if no class is large enough.
+        std::size_t buffer_size(std::size_t bytes) const {
+            if (state) {
+                for (const detail::io_pool_class& c : state->classes) {
+                    if (c.buffer_size >= bytes) {
+                        return c.buffer_size;
+                    }
+                }
+            }
+            return 0;
+        }
+
+        // Free buffers that could serve a request for `bytes`.
+        std::size_t available(std::size_t bytes) const {
+            std::size_t free_count = 0;
+            if (state) {
+                std::lock_guard<std::mutex> guard(state->lock);
+                for (const detail::io_pool_class& c : state->classes) {
+                    if (c.buffer_size >= bytes) {
+                        free_count += c.free_slots.size();
+                    }
+                }
+            }
+            return free_count;
+        }
+
+        bool is_locked() const {
+            return state && state->locked;
+        }
+    };
+
+    // pread(2) into a buffer, retried on EINTR. Short counts are returned as is.
+    inline ssize_t pread(int fd, const pointer<unsigned char>& buffer, std::size_t bytes, off_t offset) {
+        ssize_t result;
+        do {
+            result = ::pread(fd, buffer.get_raw_ptr(), bytes, offset);
+        } while (result < 0 && errno == EINTR);
+        return result;
+    }
+
+    // pwrite(2) from a buffer, retried on EINTR. Short counts are returned as is.
+    inline ssize_t pwrite(int fd, const pointer<unsigned char>& buffer, std::size_t bytes, off_t offset) {
+        ssize_t result;
+        do {
+            result = ::pwrite(fd, buffer.get_raw_ptr(), bytes, offset);
+        } while (result < 0 && errno == EINTR);
+        return result;
+    }
+
+}
+#endif // !EM_IO_BUFFER_POOL
@@ -0,0 +1,95 @@
+#ifndef EM_LAZY_POINTER
+#define EM_LAZY_POINTER
+
+#include "EMPointer.h"
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <utility>
+
+// Pointer whose object is built on first use.
+//
+// em::lazy_pointer<T> holds a factory and runs it exactly once, on the first
+// *, -> or get(), even when several threads get there at the same time. After
+// that every access is one acquire load (a plain load on x86) and a branch.
+// The factory may return a T* (adopted like em::pointer<T>(T*)) or an
+// em::pointer<T>; if it throws, the next access tries again. A factory that
+// returns null leaves the lazy_pointer null; later accesses see that from an
+// atomic flag without taking the mutex.
+//
+//     static em::lazy_pointer<Catalog> catalog([] { return new Catalog(load_catalog()); });
+//     catalog->find(...);                    // built here, on first use
+//     em::pointer<Catalog> shared = catalog; // shares ownership with the lazy_pointer
+
+namespace em {
+
+    template<typename T>
+    class lazy_pointer {
+    private:
+        std::atomic<T*> ready{ nullptr };
+        std::mutex construction;
+        std::atomic<bool> constructed{ false };
+        pointer<T> owner;
+        std::function<pointer<T>()> factory;
+
+        // Slow path. A plain mutex rather than std::call_once, which can hang when
+        // the callable throws on some standard library / sanitizer combinations.
+        T* construct() {
+            std::lock_guard<std::mutex> lock(construction);
+            if (!constructed.load(std::memory_order_relaxed)) {
+                pointer<T> built = factory();
+                factory = nullptr;
+                owner = std::move(built);
+                ready.store(owner.get_raw_ptr(), std::memory_order_release);
+                constructed.store(true, std::memory_order_release);
+            }
+            return owner.get_raw_ptr();
+        }
+
+    public:
+        template <typename F>
+        explicit lazy_pointer(F make) :
+            factory([make]() mutable -> pointer<T> { return pointer<T>(make()); })
+        {}
+
+        lazy_pointer(const lazy_pointer&) = delete;
+        lazy_pointer& operator=(const lazy_pointer&) = delete;
+
+        T* get() {
+            T* value = ready.load(std::memory_order_acquire);
+            if (value) {
+                return value;
+            }
+            // The factory already ran and returned null (ready is stored first).
+            if (constructed.load(std::memory_order_acquire)) {
+                return ready.load(std::memory_order_relaxed);
+            }
+            return construct();
+        }
+
+        T& operator*() {
+            return *get();
+        }
+
+        T* operator->() {
+            return get();
+        }
+
+        // A shared em::pointer to the object, constructing it if needed.
+        pointer<T> get_pointer() {
+            get();
+            return owner;
+        }
+
+        operator pointer<T>() {
+            return get_pointer();
+        }
+
+        // True once the factory has produced a non-null object. Never constructs.
+        bool is_constructed() const {
+            return ready.load(std::memory_order_acquire) != nullptr;
+        }
+    };
+
+}
+#endif // !EM_LAZY_POINTER
@@ -0,0 +1,352 @@
+#ifndef EM_OFFSET_POINTER
+#define EM_OFFSET_POINTER
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+// Self-relative pointers for data structures that live in relocatable memory
+// (mmap'd files, shared memory). An offset_pointer stores the distance from its
+// own address to the target, so a structure built at one address stays valid
+// wherever the whole region is mapped later.
+//
+// offset_pointer does not own anything. Copying one recomputes the offset for
+// the new location, so it can be passed around like a raw pointer, but only a
+// pointer stored *inside* the region survives relocation.
+
+namespace em {
+
+    template<typename T>
+    class offset_pointer {
+    private:
+        // A distance of 1 would point into the offset_pointer itself, so it marks null.
+        static constexpr std::ptrdiff_t null_offset = 1;
+
+        std::ptrdiff_t offset = null_offset;
+
+        void set(T* target) {
+            if (target) {
+                offset = reinterpret_cast<const char*>(target) - reinterpret_cast<const char*>(this);
+            }
+            else {
+                offset = null_offset;
+            }
+        }
+
+        T* get() const {
+            if (offset == null_offset) {
+                return nullptr;
+            }
+            return reinterpret_cast<T*>(const_cast<char*>(reinterpret_cast<const char*>(this)) + offset);
+        }
+
+    public:
+        using difference_type = std::ptrdiff_t;
+        using value_type = T;
+        using pointer_type = T*;
+        using reference = T&;
+        using iterator_category = std::random_access_iterator_tag;
+
+        offset_pointer() = default;
+
+        offset_pointer(std::nullptr_t) {}
+
+        offset_pointer(T* target) {
+            set(target);
+        }
+
+        offset_pointer(const offset_pointer& other) {
+            set(other.get());
+        }
+
+        template <typename U, typename = std::enable_if_t<std::is_convertible<U*, T*>::value>>
+        offset_pointer(const offset_pointer<U>& other) {
+            set(other.get_raw_ptr());
+        }
+
+        offset_pointer& operator=(const offset_pointer& other) {
+            set(other.get());
+            return *this;
+        }
+
+        offset_pointer& operator=(T* target) {
+            set(target);
+            return *this;
+        }
+
+        offset_pointer& operator=(std::nullptr_t) {
+            offset = null_offset;
+            return *this;
+        }
+
+        T& operator*() const {
+            return *get();
+        }
+
+        T* operator->() const {
+            return get();
+        }
+
+        T& operator[](difference_type index) const {
+            return get()[index];
+        }
+
+        operator T* () const {
+            return get();
+        }
+
+        explicit operator bool() const {
+            return offset != null_offset;
+        }
+
+        T* get_raw_ptr() const {
+            return get();
+        }
+
+        bool is_null() const {
+            return offset == null_offset;
+        }
+
+        void swap(offset_pointer& other) noexcept {
+            T* mine = get();
+            set(other.get());
+            other.set(mine);
+        }
+
+        offset_pointer& operator++() {
+            offset += sizeof(T);
+            return *this;
+        }
+
+        offset_pointer operator++(int) {
+            offset_pointer temp = *this;
+            offset += sizeof(T);
+            return temp;
+        }
+
+        offset_pointer& operator--() {
+            offset -= sizeof(T);
+            return *this;
+        }
+
+        offset_pointer operator--(int) {
+            offset_pointer temp = *this;
+            offset -= sizeof(T);
+            return temp;
+        }
+
+        offset_pointer& operator+=(difference_type n) {
+            offset += n * static_cast<difference_type>(sizeof(T));
+            return *this;
+        }
+
+        offset_pointer& operator-=(difference_type n) {
+            offset -= n * static_cast<difference_type>(sizeof(T));
+            return *this;
+        }
+
+        offset_pointer operator+(difference_type n) const {
+            return offset_pointer(get() + n);
+        }
+
+        offset_pointer operator-(difference_type n) const {
+            return offset_pointer(get() - n);
+        }
+
+        difference_type operator-(const offset_pointer& other) const {
+            return get() - other.get();
+        }
+    };
+
+    template<typename T>
+    void swap(offset_pointer<T>& lhs, offset_pointer<T>& rhs) noexcept {
+        lhs.swap(rhs);
+    }
+
+    template<typename T, typename U>
+    bool operator==(const offset_pointer<T>& lhs, const offset_pointer<U>& rhs) {
+        return lhs.get_raw_ptr() == rhs.get_raw_ptr();
+    }
+
+    template<typename T, typename U>
+    bool operator!=(const offset_pointer<T>& lhs, const offset_pointer<U>& rhs) {
+        return !(lhs == rhs);
+    }
+
+    template<typename T>
+    bool operator==(const offset_pointer<T>& lhs, std::nullptr_t) {
+        return lhs.is_null();
+    }
+
+    template<typename T>
+    bool operator==(std::nullptr_t, const offset_pointer<T>& rhs) {
+        return rhs.is_null();
+    }
+
+    template<typename T>
+    bool operator!=(const offset_pointer<T>& lhs, std::nullptr_t) {
+        return !lhs.is_null();
+    }
+
+    template<typename T>
+    bool operator!=(std::nullptr_t, const offset_pointer<T>& rhs) {
+        return !rhs.is_null();
+    }
+
+    template<typename T, typename U>
+    bool operator<(const offset_pointer<T>& lhs, const offset_pointer<U>& rhs) {
+        using Common = std::common_type_t<T*, U*>;
+        return std::less<Common>()(lhs.get_raw_ptr(), rhs.get_raw_ptr());
+    }
+
+    template<typename T, typename U>
+    bool operator>(const offset_pointer<T>& lhs, const offset_pointer<U>& rhs) {
+        return rhs < lhs;
+    }
+
+    template<typename T, typename U>
+    bool operator<=(const offset_pointer<T>& lhs, const offset_pointer<U>& rhs) {
+        return !(rhs < lhs);
+    }
+
+    template<typename T, typename U>
+    bool operator>=(const offset_pointer<T>& lhs, const offset_pointer<U>& rhs) {
+        return !(lhs < rhs);
+    }
+
+    // Bump allocator whose whole state lives at the start of the region it manages.
+    //
+    // create() formats a region, attach() reopens one that was formatted earlier,
+    // possibly at a different address. Objects are never destroyed individually,
+    // so only trivially destructible types (node structs made of offset_pointers,
+    // integers and fixed arrays) may be placed in it. Not thread-safe.
+    class offset_arena {
+    private:
+        struct header {
+            std::uint64_t magic;
+            std::uint64_t capacity;
+            std::uint64_t used;
+            std::int64_t root;
+        };
+
+        static constexpr std::uint64_t arena_magic = 0x454d4f4646534554ull; // "EMOFFSET"
+
+        unsigned char* base = nullptr;
+
+        header* head() const {
+            return reinterpret_cast<header*>(base);
+        }
+
+        explicit offset_arena(unsigned char* region) : base(region) {}
+
+    public:
+        offset_arena() = default;
+
+        // Formats `size` bytes at `region`. Returns an invalid arena if it is too small.
+        static offset_arena create(void* region, std::size_t size) {
+            if (!region || size < sizeof(header)) {
+                return offset_arena();
+            }
+            header* h = new(region) header;
+            h->magic = arena_magic;
+            h->capacity = size;
+            h->used = sizeof(header);
+            h->root = 0;
+            return offset_arena(static_cast<unsigned char*>(region));
+        }
+
+        // Reopens a region formatted by create(). `size` must cover the whole arena.
+        static offset_arena attach(void* region, std::size_t size) {
+            if (!region || size < sizeof(header)) {
+                return offset_arena();
+            }
+            header* h = static_cast<header*>(region);
+            if (h->magic != arena_magic || h->capacity > size || h->used > h->capacity) {
+                return offset_arena();
+            }
+            return offset_arena(static_cast<unsigned char*>(region));
+        }
+
+        explicit operator bool() const {
+            return base != nullptr;
+        }
+
+        void* data() const {
+            return base;
+        }
+
+        std::size_t capacity() const {
+            return base ? static_cast<std::size_t>(head()->capacity) : 0;
+        }
+
+        std::size_t used() const {
+            return base ? static_cast<std::size_t>(head()->used) : 0;
+        }
+
+        bool contains(const void* address) const {
+            const unsigned char* p = static_cast<const unsigned char*>(address);
+            return base && p >= base && p < base + head()->capacity;
+        }
+
+        // Returns nullptr when the arena is full or `alignment` is not a power of two.
+        void* allocate(std::size_t bytes, std::size_t alignment = alignof(std::max_align_t)) {
+            if (!base || alignment == 0 || (alignment & (alignment - 1)) != 0) {
+                return nullptr;
+            }
+            header* h = head();
+            std::uintptr_t start = reinterpret_cast<std::uintptr_t>(base) + static_cast<std::uintptr_t>(h->used);
+            std::uint64_t padding = (0 - start) & static_cast<std::uintptr_t>(alignment - 1);
+            // Compare against what is left rather than adding, which could wrap.
+            if (padding > h->capacity - h->used || bytes > h->capacity - h->used - padding) {
+                return nullptr;
+            }
+            h->used += padding + bytes;
+            return reinterpret_cast<void*>(start + padding);
+        }
+
+        template<typename T, typename... Args>
+        T* make(Args&&... args) {
+            static_assert(std::is_trivially_destructible<T>::value, "offset_arena never runs destructors");
+            void* storage = allocate(sizeof(T), alignof(T));
+            return storage ? new(storage) T(std::forward<Args>(args)...) : nullptr;
+        }
+
+        template<typename T>
+        T* make_array(std::size_t count) {
+            static_assert(std::is_trivially_destructible<T>::value, "offset_arena never runs destructors");
+            if (count > static_cast<std::size_t>(-1) / sizeof(T)) {
+                return nullptr;
+            }
+            T* storage = static_cast<T*>(allocate(sizeof(T) * count, alignof(T)));
+            if (storage) {
+                for (std::size_t i = 0; i < count; ++i) {
+                    new(storage + i) T();
+                }
+            }
+            return storage;
+        }
+
+        // The entry point of the stored structure, kept in the arena header.
+        template<typename T>
+        void set_root(T* root) {
+            if (!base) {
+                return;
+            }
+            head()->root = root ? static_cast<std::int64_t>(reinterpret_cast<unsigned char*>(root) - base) : 0;
+        }
+
+        template<typename T>
+        T* get_root() const {
+            if (!base || head()->root == 0) {
+                return nullptr;
+            }
+            return reinterpret_cast<T*>(base + head()->root);
+        }
+    };
+
+}
+#endif // !EM_OFFSET_POINTER
@@ -0,0 +1,657 @@
+#ifndef EM_PERSISTENT
+#define EM_PERSISTENT
+
+#include "EMPointer.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <utility>
+#include <vector>
+
+// Persistent containers whose nodes are shared by reference counting.
+//
+// em::pvector<T> is a 32-way radix trie with a separate tail leaf (the layout
+// of Clojure's vector). em::pmap<K, V> is a hash array mapped trie keeping
+// entries and sub-nodes in separate bitmap-indexed arrays (CHAMP). Copying
+// either container is O(1) and is the way to take a snapshot. An update
+// returns a new container; it copies only the nodes on the path from the root
+// to the changed leaf and shares everything else with the old one.
+//
+// as_transient() gives a mutable working copy for batches of updates. It copies
+// a node only while its reference count shows it is still shared with a snapshot,
+// so after the first write to a path, later writes to it happen in place.
+// persistent() turns it back into an ordinary snapshot at O(1) cost, and the
+// transient may keep going afterwards without disturbing that snapshot.
+//
+// Snapshots may be read from any number of threads. A single transient is
+// not synchronised.
+
+namespace em {
+
+    namespace detail {
+
+        // Reference count at the head of every trie node. A copied node starts
+        // out unshared, whatever the count of the node it was copied from.
+        struct counted_node {
+            std::atomic<int> refs{ 1 };
+
+            counted_node() = default;
+            counted_node(const counted_node&) : refs(1) {}
+            counted_node& operator=(const counted_node&) { return *this; }
+        };
+
+        // One word per child slot: the count lives in the node itself, so a
+        // 32-way branch holds 32 plain pointers rather than 32 em::pointers.
+        template<typename Node>
+        class node_ref {
+        private:
+            Node* node = nullptr;
+
+            void release() {
+                if (node && node->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                    delete node;
+                }
+            }
+
+        public:
+            node_ref() = default;
+            node_ref(std::nullptr_t) {}
+
+            // Takes over the reference `created` was built with.
+            explicit node_ref(Node* created) : node(created) {}
+
+            node_ref(const node_ref& other) : node(other.node) {
+                if (node) {
+                    node->refs.fetch_add(1, std::memory_order_relaxed);
+                }
+            }
+
+            node_ref(node_ref&& other) noexcept : node(other.node) {
+                other.node = nullptr;
+            }
+
+            node_ref& operator=(node_ref other) noexcept {
+                std::swap(node, other.node);
+                return *this;
+            }
+
+            ~node_ref() {
+                release();
+            }
+
+            explicit operator bool() const {
+                return node != nullptr;
+            }
+
+            Node* get() const {
+                return node;
+            }
+
+            Node& operator*() const {
+                return *node;
+            }
+
+            Node* operator->() const {
+                return node;
+            }
+
+            // Acquire pairs with the release in other owners' destructors, so a
+            // count of 1 means their reads of the node are finished.
+            int use_count() const {
+                return node ? node->refs.load(std::memory_order_acquire) : 0;
+            }
+        };
+
+        // Makes `slot` the sole owner of its node, copying the node if it is shared.
+        template<typename Node>
+        Node& own_node(node_ref<Node>& slot) {
+            if (!slot) {
+                slot = node_ref<Node>(new Node());
+            }
+            else if (slot.use_count() != 1) {
+                slot = node_ref<Node>(new Node(*slot));
+            }
+            return *slot;
+        }
+
+        template<typename T>
+        struct pvector_leaf : counted_node {
+            std::vector<T> values;
+        };
+
+        // Branches one level above the leaves use `leaves`, all others `branches`.
+        template<typename T>
+        struct pvector_branch : counted_node {
+            std::vector<node_ref<pvector_branch>> branches;
+            std::vector<node_ref<pvector_leaf<T>>> leaves;
+        };
+
+        template<typename K, typename V>
+        struct pmap_node : counted_node {
+            std::uint32_t datamap = 0;
+            std::uint32_t nodemap = 0;
+            std::vector<std::pair<K, V>> entries;   // by rank in datamap; every entry once hashes run out
+            std::vector<node_ref<pmap_node>> children;
+
+            static unsigned rank(std::uint32_t map, std::uint32_t bit) {
+                std::uint32_t below = map & (bit - 1);
+                unsigned count = 0;
+                while (below) {
+                    below &= below - 1;
+                    ++count;
+                }
+                return count;
+            }
+        };
+
+    } // namespace detail
+
+    template<typename T>
+    class pvector {
+    private:
+        using leaf = detail::pvector_leaf<T>;
+        using branch = detail::pvector_branch<T>;
+
+        static constexpr unsigned bits = 5;
+        static constexpr std::size_t width = std::size_t(1) << bits;
+        static constexpr std::size_t mask = width - 1;
+
+        std::size_t count = 0;
+        unsigned shift = bits;
+        detail::node_ref<branch> root;
+        detail::node_ref<leaf> tail;
+
+        std::size_t tail_offset() const {
+            return count < width ? 0 : ((count - 1) >> bits) << bits;
+        }
+
+        const leaf& leaf_for(std::size_t index) const {
+            if (index >= tail_offset()) {
+                return *tail;
+            }
+            const branch* node = root.get();
+            for (unsigned level = shift; level > bits; level -= bits) {
+                node = node->branches[(index >> level) & mask].get();
+            }
+            return *node->leaves[(index >> bits) & mask];
+        }
+
+        static detail::node_ref<branch> new_path(unsigned level, detail::node_ref<leaf> full) {
+            detail::node_ref<branch> path;
+            branch& node = detail::own_node(path);
+            if (level == bits) {
+                node.leaves.push_back(std::move(full));
+            }
+            else {
+                node.branches.push_back(new_path(level - bits, std::move(full)));
+            }
+            return path;
+        }
+
+        // Appends the full tail as the trie's last leaf; `count` still includes it.
+        void push_tail(detail::node_ref<branch>& slot, unsigned level, detail::node_ref<leaf> full) {
+            branch& node = detail::own_node(slot);
+            if (level == bits) {
+                node.leaves.push_back(std::move(full));
+                return;
+            }
+            std::size_t child = ((count - 1) >> level) & mask;
+            if (child < node.branches.size()) {
+                push_tail(node.branches[child], level - bits, std::move(full));
+            }
+            else {
+                node.branches.push_back(new_path(level - bits, std::move(full)));
+            }
+        }
+
+        // Detaches the trie's last leaf.
+        static detail::node_ref<leaf> pop_last_leaf(detail::node_ref<branch>& slot, unsigned level) {
+            branch& node = detail::own_node(slot);
+            if (level == bits) {
+                detail::node_ref<leaf> last = std::move(node.leaves.back());
+                node.leaves.pop_back();
+                return last;
+            }
+            detail::node_ref<branch>& child = node.branches.back();
+            detail::node_ref<leaf> last = pop_last_leaf(child, level - bits);
+            if (child->branches.empty() && child->leaves.empty()) {
+                node.branches.pop_back();
+            }
+            return last;
+        }
+
+        void push_back_in_place(T value) {
+            if (count - tail_offset() < width) {
+                detail::own_node(tail).values.push_back(std::move(value));
+                ++count;
+                return;
+            }
+            if ((count >> bits) > (std::size_t(1) << shift)) {
+                detail::node_ref<branch> grown;
+                branch& node = detail::own_node(grown);
+                node.branches.push_back(std::move(root));
+                node.branches.push_back(new_path(shift, std::move(tail)));
+                root = std::move(grown);
+                shift += bits;
+            }
+            else {
+                push_tail(root, shift, std::move(tail));
+            }
+            tail = nullptr;
+            detail::own_node(tail).values.push_back(std::move(value));
+            ++count;
+        }
+
+        void set_in_place(std::size_t index, T value) {
+            if (index >= tail_offset()) {
+                detail::own_node(tail).values[index & mask] = std::move(value);
+                return;
+            }
+            detail::node_ref<branch>* slot = &root;
+            for (unsigned level = shift; level > bits; level -= bits) {
+                slot = &detail::own_node(*slot).branches[(index >> level) & mask];
+            }
+            detail::node_ref<leaf>& target = detail::own_node(*slot).leaves[(index >> bits) & mask];
+            detail::own_node(target).values[index & mask] = std::move(value);
+        }
+
+        void pop_back_in_place() {
+            if (count == 0) {
+                return;
+            }
+            if (count == 1) {
+                clear_in_place();
+                return;
+            }
+            if (count - tail_offset() > 1) {
+                detail::own_node(tail).values.pop_back();
+                --count;
+                return;
+            }
+            tail = pop_last_leaf(root, shift);
+            --count;
+            if (shift > bits && root->branches.size() == 1) {
+                detail::node_ref<branch> only = root->branches[0];
+                root = std::move(only);
+                shift -= bits;
+            }
+        }
+
+        void clear_in_place() {
+            count = 0;
+            shift = bits;
+            root = nullptr;
+            tail = nullptr;
+        }
+
+    public:
+        using value_type = T;
+
+        class transient;
+
+        pvector() = default;
+
+        std::size_t size() const {
+            return count;
+        }
+
+        bool empty() const {
+            return count == 0;
+        }
+
+        // No bounds check, like operator[] on a raw array.
+        const T& operator[](std::size_t index) const {
+            return leaf_for(index).values[index & mask];
+        }
+
+        const T& back() const {
+            return tail->values.back();
+        }
+
+        pvector push_back(T value) const {
+            pvector updated(*this);
+            updated.push_back_in_place(std::move(value));
+            return updated;
+        }
+
+        pvector set(std::size_t index, T value) const {
+            pvector updated(*this);
+            updated.set_in_place(index, std::move(value));
+            return updated;
+        }
+
+        pvector pop_back() const {
+            pvector updated(*this);
+            updated.pop_back_in_place();
+            return updated;
+        }
+
+        transient as_transient() const;
+
+        // Calls f(value) for every element in order, one leaf at a time.
+        template<typename F>
+        void for_each(F f) const {
+            std::size_t offset = tail_offset();
+            for (std::size_t start = 0; start < offset; start += width) {
+                for (const T& value : leaf_for(start).values) {
+                    f(value);
+                }
+            }
+            if (tail) {
+                for (const T& value : tail->values) {
+                    f(value);
+                }
+            }
+        }
+    };
+
+    template<typename T>
+    class pvector<T>::transient {
+    private:
+        pvector working;
+
+    public:
+        transient() = default;
+        explicit transient(const pvector& from) : working(from) {}
+
+        std::size_t size() const {
+            return working.size();
+        }
+
+        bool empty() const {
+            return working.empty();
+        }
+
+        const T& operator[](std::size_t index) const {
+            return working[index];
+        }
+
+        void push_back(T value) {
+            working.push_back_in_place(std::move(value));
+        }
+
+        void set(std::size_t index, T value) {
+            working.set_in_place(index, std::move(value));
+        }
+
+        void pop_back() {
+            working.pop_back_in_place();
+        }
+
+        void clear() {
+            working.clear_in_place();
+        }
+
+        // A snapshot of the current contents; the transient stays usable.
+        pvector persistent() const {
+            return working;
+        }
+    };
+
+    template<typename T>
+    typename pvector<T>::transient pvector<T>::as_transient() const {
+        return transient(*this);
+    }
+
+    template<typename K, typename V>
+    class pmap {
+    private:
+        using node = detail::pmap_node<K, V>;
+        using entry = std::pair<K, V>;
+
+        static constexpr unsigned bits = 5;
+        static constexpr unsigned hash_bits = sizeof(std::size_t) * 8;
+
+        std::size_t count = 0;
+        detail::node_ref<node> root;
+
+        static std::size_t hash_of(const K& key) {
+            return std::hash<K>()(key);
+        }
+
+        static std::uint32_t bit_for(std::size_t hash, unsigned shift) {
+            return std::uint32_t(1) << ((hash >> shift) & 31);
+        }
+
+        static detail::node_ref<node> merge(entry first, std::size_t first_hash, entry second, std::size_t second_hash, unsigned shift) {
+            detail::node_ref<node> merged;
+            node& n = detail::own_node(merged);
+            if (shift >= hash_bits) {
+                n.entries.push_back(std::move(first));
+                n.entries.push_back(std::move(second));
+                return merged;
+            }
+            std::uint32_t first_bit = bit_for(first_hash, shift);
+            std::uint32_t second_bit = bit_for(second_hash, shift);
+            if (first_bit == second_bit) {
+                n.nodemap = first_bit;
+                n.children.push_back(merge(std::move(first), first_hash, std::move(second), second_hash, shift + bits));
+            }
+            else {
+                n.datamap = first_bit | second_bit;
+                if (first_bit < second_bit) {
+                    n.entries.push_back(std::move(first));
+                    n.entries.push_back(std::move(second));
+                }
+                else {
+                    n.entries.push_back(std::move(second));
+                    n.entries.push_back(std::move(first));
+                }
+            }
+            return merged;
+        }
+
+        // Returns true if the key was not present before.
+        static bool set_in(detail::node_ref<node>& slot, K key, V value, std::size_t hash, unsigned shift) {
+            node& n = detail::own_node(slot);
+            if (shift >= hash_bits) {
+                for (entry& e : n.entries) {
+                    if (e.first == key) {
+                        e.second = std::move(value);
+                        return false;
+                    }
+                }
+                n.entries.emplace_back(std::move(key), std::move(value));
+                return true;
+            }
+            std::uint32_t bit = bit_for(hash, shift);
+            if (n.datamap & bit) {
+                unsigned index = node::rank(n.datamap, bit);
+                entry& existing = n.entries[index];
+                if (existing.first == key) {
+                    existing.second = std::move(value);
+                    return false;
+                }
+                std::size_t existing_hash = hash_of(existing.first);
+                detail::node_ref<node> child = merge(std::move(existing), existing_hash, entry(std::move(key), std::move(value)), hash, shift + bits);
+                n.entries.erase(n.entries.begin() + index);
+                n.datamap ^= bit;
+                n.children.insert(n.children.begin() + node::rank(n.nodemap, bit), std::move(child));
+                n.nodemap |= bit;
+                return true;
+            }
+            if (n.nodemap & bit) {
+                return set_in(n.children[node::rank(n.nodemap, bit)], std::move(key), std::move(value), hash, shift + bits);
+            }
+            n.entries.insert(n.entries.begin() + node::rank(n.datamap, bit), entry(std::move(key), std::move(value)));
+            n.datamap |= bit;
+            return true;
+        }
+
+        // The key must be present.
+        static void erase_in(detail::node_ref<node>& slot, const K& key, std::size_t hash, unsigned shift) {
+            node& n = detail::own_node(slot);
+            if (shift >= hash_bits) {
+                for (std::size_t i = 0; i < n.entries.size(); ++i) {
+                    if (n.entries[i].first == key) {
+                        n.entries.erase(n.entries.begin() + i);
+                        return;
+                    }
+                }
+                return;
+            }
+            std::uint32_t bit = bit_for(hash, shift);
+            if (n.datamap & bit) {
+                n.entries.erase(n.entries.begin() + node::rank(n.datamap, bit));
+                n.datamap ^= bit;
+                return;
+            }
+            unsigned index = node::rank(n.nodemap, bit);
+            detail::node_ref<node>& child = n.children[index];
+            erase_in(child, key, hash, shift + bits);
+            // A child left with a single entry is folded back into this node.
+            if (child->children.empty() && child->entries.size() == 1) {
+                entry last = std::move(child->entries.front());
+                n.children.erase(n.children.begin() + index);
+                n.nodemap ^= bit;
+                n.entries.insert(n.entries.begin() + node::rank(n.datamap, bit), std::move(last));
+                n.datamap |= bit;
+            }
+        }
+
+        void set_in_place(K key, V value) {
+            std::size_t hash = hash_of(key);
+            if (set_in(root, std::move(key), std::move(value), hash, 0)) {
+                ++count;
+            }
+        }
+
+        bool erase_in_place(const K& key) {
+            if (!find(key)) {
+                return false;
+            }
+            erase_in(root, key, hash_of(key), 0);
+            if (--count == 0) {
+                root = nullptr;
+            }
+            return true;
+        }
+
+        template<typename F>
+        static void for_each_in(const node& n, F& f) {
+            for (const entry& e : n.entries) {
+                f(e.first, e.second);
+            }
+            for (const detail::node_ref<node>& child : n.children) {
+                for_each_in(*child, f);
+            }
+        }
+
+    public:
+        using key_type = K;
+        using mapped_type = V;
+
+        class transient;
+
+        pmap() = default;
+
+        std::size_t size() const {
+            return count;
+        }
+
+        bool empty() const {
+            return count == 0;
+        }
+
+        // Pointer to the value stored under `key`, or nullptr.
+        const V* find(const K& key) const {
+            const node* n = root.get();
+            std::size_t hash = hash_of(key);
+            for (unsigned shift = 0; n; shift += bits) {
+                if (shift >= hash_bits) {
+                    for (const entry& e : n->entries) {
+                        if (e.first == key) {
+                            return &e.second;
+                        }
+                    }
+                    return nullptr;
+                }
+                std::uint32_t bit = bit_for(hash, shift);
+                if (n->datamap & bit) {
+                    const entry& e = n->entries[node::rank(n->datamap, bit)];
+                    return e.first == key ? &e.second : nullptr;
+                }
+                if (!(n->nodemap & bit)) {
+                    return nullptr;
+                }
+                n = n->children[node::rank(n->nodemap, bit)].get();
+            }
+            return nullptr;
+        }
+
+        bool contains(const K& key) const {
+            return find(key) != nullptr;
+        }
+
+        // Inserts or replaces the value under `key`.
+        pmap set(K key, V value) const {
+            pmap updated(*this);
+            updated.set_in_place(std::move(key), std::move(value));
+            return updated;
+        }
+
+        // Returns the same snapshot, without copying anything, if `key` is absent.
+        pmap erase(const K& key) const {
+            pmap updated(*this);
+            updated.erase_in_place(key);
+            return updated;
+        }
+
+        transient as_transient() const;
+
+        // Calls f(key, value) for every entry, in no particular order.
+        template<typename F>
+        void for_each(F f) const {
+            if (root) {
+                for_each_in(*root, f);
+            }
+        }
+    };
+
+    template<typename K, typename V>
+    class pmap<K, V>::transient {
+    private:
+        pmap working;
+
+    public:
+        transient() = default;
+        explicit transient(const pmap& from) : working(from) {}
+
+        std::size_t size() const {
+            return working.size();
+        }
+
+        bool empty() const {
+            return working.empty();
+        }
+
+        const V* find(const K& key) const {
+            return working.find(key);
+        }
+
+        bool contains(const K& key) const {
+            return working.contains(key);
+        }
+
+        void set(K key, V value) {
+            working.set_in_place(std::move(key), std::move(value));
+        }
+
+        bool erase(const K& key) {
+            return working.erase_in_place(key);
+        }
+
+        // A snapshot of the current contents; the transient stays usable.
+        pmap persistent() const {
+            return working;
+        }
+    };
+
+    template<typename K, typename V>
+    typename pmap<K, V>::transient pmap<K, V>::as_transient() const {
+        return transient(*this);
+    }
+
+}
+#endif // !EM_PERSISTENT
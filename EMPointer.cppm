@@ -0,0 +1,23 @@
+// C++20 module interface for the core pointer: `import em.pointer;`
+//
+// The header stays the single source of truth; this unit includes it in the
+// global module fragment and re-exports its names, so both forms can be mixed
+// in one program. The std::hash specialisation comes along with em::pointer.
+
+module;
+
+#include "EMPointer.h"
+
+export module em.pointer;
+
+export namespace em {
+    using em::pointer;
+    using em::borrow;
+    using em::swap;
+    using em::operator==;
+    using em::operator!=;
+    using em::operator<;
+    using em::operator<=;
+    using em::operator>;
+    using em::operator>=;
+}
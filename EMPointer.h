@@ -1,7 +1,8 @@
 #ifndef EM_POINTER
 #define EM_POINTER
 
-#include <iostream>
+#include "EMPointerFwd.h"
+#include <atomic>
 #include <utility>
 #include <cstddef>
 #include <new>
@@ -11,14 +12,66 @@
 
 namespace em {
 
-    template<typename T> class pointer;
+    namespace detail {
+
+#if defined(EM_POINTER_PROFILING)
+        struct profile_sample;
+#endif
+
+        // Shared count behind every owning em::pointer. Normally it is allocated on
+        // its own and the pointer deletes the object itself. A block with `dispose`
+        // set owns the object instead: on the last release, dispose(block) destroys
+        // the object and frees the block (e.g. both live in a slab).
+        struct ref_block {
+            std::atomic<int> count;
+            void (*dispose)(ref_block*);
+#if defined(EM_POINTER_PROFILING)
+            profile_sample* sample = nullptr; // set while the allocation is sampled
+#endif
+
+            explicit ref_block(int initial, void (*disposer)(ref_block*) = nullptr) :
+                count(initial),
+                dispose(disposer)
+            {}
+        };
+
+        struct pointer_access;
+
+#if defined(EM_POINTER_PROFILING)
+        // Defined in EMPointerProfiler.h.
+        inline void profile_allocation(ref_block* block, std::size_t bytes);
+        inline void profile_release(ref_block* block);
+#endif
+
+        // Allocation profiling hooks (EMPointerProfiler.h). Without
+        // EM_POINTER_PROFILING they compile to nothing.
+        inline void sample_allocation(ref_block* block, std::size_t bytes) {
+#if defined(EM_POINTER_PROFILING)
+            profile_allocation(block, bytes);
+#else
+            (void)block;
+            (void)bytes;
+#endif
+        }
+
+        inline void sample_release(ref_block* block) {
+#if defined(EM_POINTER_PROFILING)
+            if (block->sample) {
+                profile_release(block);
+            }
+#else
+            (void)block;
+#endif
+        }
+
+    } // namespace detail
 
     template<typename T>
     class pointer {
         static_assert(!std::is_void<T>::value, "Use pointer<void> specialization for void");
 
     private:
-        int* ptr_counter = nullptr;
+        detail::ref_block* ptr_counter = nullptr;
         T* value = nullptr;
         T* original_value = nullptr;
         bool isArray = false;
@@ -33,27 +86,33 @@ namespace em {
                 return;
             }
 
-            --(*ptr_counter);
-
-            if (*ptr_counter == 0) {
-                delete ptr_counter;
+            if (ptr_counter->count.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                detail::ref_block* block = ptr_counter;
                 ptr_counter = nullptr;
+                detail::sample_release(block);
 
                 T* pointer_to_delete = original_value;
 
-                if (deleter) {
-                    try {
-                        deleter(pointer_to_delete);
-                    }
-                    catch (...) { /* Cannot throw */ }
+                if (block->dispose) {
+                    block->dispose(block);
                 }
                 else {
-                    if (pointer_to_delete) {
-                        if (isArray) {
-                            delete[] pointer_to_delete;
+                    delete block;
+
+                    if (deleter) {
+                        try {
+                            deleter(pointer_to_delete);
                         }
-                        else {
-                            delete pointer_to_delete;
+                        catch (...) { /* Cannot throw */ }
+                    }
+                    else {
+                        if (pointer_to_delete) {
+                            if (isArray) {
+                                delete[] pointer_to_delete;
+                            }
+                            else {
+                                delete pointer_to_delete;
+                            }
                         }
                     }
                 }
@@ -73,15 +132,18 @@ namespace em {
             }
         }
 
-        void setup_control_block(T* val, bool is_arr, std::function<void(T*)> d) {
+        void setup_control_block(T* val, bool is_arr, std::function<void(T*)> d, std::size_t bytes = sizeof(T)) {
             value = val;
             original_value = val;
             isArray = is_arr;
             deleter = std::move(d);
 
             if (value) {
-                ptr_counter = new(std::nothrow) int(1);
-                if (!ptr_counter) {
+                ptr_counter = new(std::nothrow) detail::ref_block(1);
+                if (ptr_counter) {
+                    detail::sample_allocation(ptr_counter, bytes);
+                }
+                else {
                     T* pointer_to_delete = original_value;
                     if (deleter && pointer_to_delete) {
                         try { deleter(pointer_to_delete); }
@@ -105,6 +167,8 @@ namespace em {
         }
 
         template <typename U> friend class pointer;
+        template <typename U> friend pointer<U> borrow(U* val);
+        friend struct detail::pointer_access;
 
     public:
         using difference_type = std::ptrdiff_t;
@@ -121,7 +185,7 @@ namespace em {
             catch (...) {
                 allocated_value = nullptr;
             }
-            setup_control_block(allocated_value, true, nullptr);
+            setup_control_block(allocated_value, true, nullptr, sizeof(T) * size);
         }
 
         pointer(T* val) {
@@ -165,7 +229,7 @@ namespace em {
             deleter(other.deleter)
         {
             if (ptr_counter) {
-                ++(*ptr_counter);
+                ptr_counter->count.fetch_add(1, std::memory_order_relaxed);
             }
         }
 
@@ -245,10 +309,17 @@ namespace em {
             return original_value;
         }
 
+        // Objects whose block disposes of them (e.g. slab-allocated) cannot be released.
         T* do_not_manage() {
             T* released_ptr = original_value;
-            if (ptr_counter) {
-                --(*ptr_counter);
+            if (ptr_counter && ptr_counter->dispose) {
+                released_ptr = nullptr;
+            }
+            else if (ptr_counter) {
+                if (ptr_counter->count.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                    detail::sample_release(ptr_counter);
+                    delete ptr_counter;
+                }
                 ptr_counter = nullptr;
                 value = nullptr;
                 original_value = nullptr;
@@ -267,7 +338,7 @@ namespace em {
         }
 
         int use_count() const {
-            return ptr_counter ? *ptr_counter : 0;
+            return ptr_counter ? ptr_counter->count.load(std::memory_order_acquire) : 0;
         }
 
         bool is_array() const {
@@ -344,75 +415,187 @@ namespace em {
         }
     };
 
-    // --- Specialization for void ---
-    template<>
-    class pointer<void> {
-    private:
-        int* ptr_counter = nullptr;
-        void* value = nullptr;
-        void* original_value = nullptr;
-        std::function<void(void*)> deleter = nullptr;
+    namespace detail {
 
-        void delete_ptr() {
-            if (!ptr_counter) {
-                value = nullptr;
-                original_value = nullptr;
-                deleter = nullptr;
-                return;
-            }
+        using type_id = const void*;
 
-            --(*ptr_counter);
+        // One distinct address per type stands in for typeid, so pointer<void>
+        // can check types without RTTI. The tag is writable on purpose: identical
+        // read-only constants may be folded into one by the linker (ICF), which
+        // would give two types the same id.
+        template<typename T>
+        struct type_tag {
+            static char id;
+        };
 
-            if (*ptr_counter == 0) {
-                delete ptr_counter;
-                ptr_counter = nullptr;
+        template<typename T>
+        char type_tag<T>::id = 0;
+
+        template<typename T>
+        constexpr type_id type_id_of() {
+            return &type_tag<typename std::remove_cv<T>::type>::id;
+        }
 
-                void* pointer_to_delete = original_value;
+        // Deleter for a pointer<void> that counts references to an object it does
+        // not own.
+        struct no_delete {
+            void operator()(const volatile void*) const {}
+        };
 
-                if (deleter) {
-                    try {
-                        deleter(pointer_to_delete);
-                    }
-                    catch (...) { /* Cannot throw */ }
+        // An empty std::function deleter means "no deleter", as nullptr does.
+        template<typename D>
+        bool is_empty_deleter(const D&) {
+            return false;
+        }
+
+        template<typename R, typename... Args>
+        bool is_empty_deleter(const std::function<R(Args...)>& d) {
+            return !d;
+        }
+
+        template<typename D, typename T, typename = void>
+        struct is_deleter_for : std::false_type {};
+
+        template<typename D, typename T>
+        struct is_deleter_for<D, T, decltype(void(std::declval<D&>()(std::declval<T*>())))> : std::true_type {};
+
+        // What pointer<void> knows about the object it owns. There is one static
+        // table per (type, deleter) pair; blocks only point to it.
+        struct erased_ops {
+            type_id type;
+            void (*destroy)(ref_block*);  // destroys the object and frees the block
+            void* (*release)(ref_block*); // frees the block and returns the object, or nullptr if it cannot
+        };
+
+        // The block behind every owning pointer<void>. `dispose` is ops->destroy,
+        // so a pointer<T> recovered by cast<T>() shares it as is.
+        struct erased_block : ref_block {
+            const erased_ops* ops;
+
+            explicit erased_block(const erased_ops* table) :
+                ref_block(1, table->destroy),
+                ops(table)
+            {}
+        };
+
+        // Owns `object` and hands it to `deleter`, stored by value.
+        template<typename T, typename D>
+        struct erased_deleter_block : erased_block {
+            static const erased_ops table;
+
+            T* object;
+            D deleter;
+
+            erased_deleter_block(T* obj, D&& d) :
+                erased_block(&table),
+                object(obj),
+                deleter(std::move(d))
+            {}
+
+            static void destroy(ref_block* released) {
+                erased_deleter_block* self = static_cast<erased_deleter_block*>(released);
+                try {
+                    self->deleter(self->object);
                 }
+                catch (...) { /* Cannot throw */ }
+                delete self;
+            }
 
-                value = nullptr;
-                original_value = nullptr;
-                deleter = nullptr;
+            static void* release(ref_block* released) {
+                erased_deleter_block* self = static_cast<erased_deleter_block*>(released);
+                void* object = self->object;
+                delete self;
+                return object;
             }
-            else {
-                ptr_counter = nullptr;
-                value = nullptr;
-                original_value = nullptr;
-                deleter = nullptr;
+        };
+
+        template<typename T, typename D>
+        const erased_ops erased_deleter_block<T, D>::table = { type_id_of<T>(), &destroy, &release };
+
+        // Keeps a typed pointer alive, so a pointer<void> made from a pointer<T>
+        // shares its ownership and deleter.
+        template<typename T>
+        struct erased_owner_block : erased_block {
+            static const erased_ops table;
+
+            pointer<T> owner;
+
+            explicit erased_owner_block(pointer<T>&& p) :
+                erased_block(&table),
+                owner(std::move(p))
+            {}
+
+            static void destroy(ref_block* released) {
+                delete static_cast<erased_owner_block*>(released);
             }
-        }
 
-        void setup_control_block(void* val, std::function<void(void*)> d) {
-            value = val;
-            original_value = val;
-            deleter = std::move(d);
-            if (value) {
-                ptr_counter = new(std::nothrow) int(1);
-                if (!ptr_counter) {
-                    void* pointer_to_delete = original_value;
-                    if (deleter && pointer_to_delete) {
-                        try { deleter(pointer_to_delete); }
-                        catch (...) {}
-                    }
-                    value = nullptr;
-                    original_value = nullptr;
-                    deleter = nullptr;
+            static void* release(ref_block* released) {
+                erased_owner_block* self = static_cast<erased_owner_block*>(released);
+                if (self->owner.use_count() != 1) {
+                    return nullptr;
+                }
+                void* object = self->owner.do_not_manage();
+                if (object) {
+                    delete self;
                 }
+                return object;
             }
-            else {
-                ptr_counter = nullptr;
-                original_value = nullptr;
-                deleter = nullptr;
+        };
+
+        template<typename T>
+        const erased_ops erased_owner_block<T>::table = { type_id_of<T>(), &destroy, &release };
+
+    } // namespace detail
+
+    // --- Specialization for void ---
+    // A type-erased owner. The deleter and the object's type live in the control
+    // block (see detail::erased_block), so the handle itself is three words and
+    // copying it only touches the count. get<T>() and cast<T>() give the object
+    // back as a T only if it was stored as a T.
+    template<>
+    class pointer<void> {
+    private:
+        detail::ref_block* ptr_counter = nullptr;
+        void* value = nullptr;
+        void* original_value = nullptr;
+
+        const detail::erased_ops* ops() const {
+            return ptr_counter ? static_cast<detail::erased_block*>(ptr_counter)->ops : nullptr;
+        }
+
+        void delete_ptr() {
+            if (ptr_counter && ptr_counter->count.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                ptr_counter->dispose(ptr_counter);
             }
+            ptr_counter = nullptr;
+            value = nullptr;
+            original_value = nullptr;
+        }
+
+        template<typename T, typename D>
+        void setup_control_block(T* val, D&& d) {
+            if (!val) {
+                return;
+            }
+            if (detail::is_empty_deleter(d)) {
+                setup_control_block(val, detail::no_delete());
+                return;
+            }
+            using block_type = detail::erased_deleter_block<T, typename std::decay<D>::type>;
+            block_type* block = new(std::nothrow) block_type(val, std::move(d));
+            if (!block) {
+                try { d(val); }
+                catch (...) {}
+                return;
+            }
+            ptr_counter = block;
+            value = block->object;
+            original_value = block->object;
         }
 
         template <typename U> friend class pointer;
+        template <typename U> friend pointer<U> borrow(U* val);
+        friend struct detail::pointer_access;
 
     public:
         using difference_type = std::ptrdiff_t;
@@ -422,51 +605,58 @@ namespace em {
         pointer() = default;
         pointer(std::nullptr_t) : pointer() {}
 
-        pointer(void* val, std::function<void(void*)> d) {
+        // `d` is stored by value in the control block and called with `val` (a T*)
+        // on the last release. The object is recorded as a T. A nullptr or empty
+        // std::function deleter counts references without ever deleting the object.
+        template <typename T, typename D, typename = std::enable_if_t<detail::is_deleter_for<D, T>::value>>
+        pointer(T* val, D d) {
             setup_control_block(val, std::move(d));
         }
 
         template <typename T>
-        pointer(T* val, std::function<void(T*)> d) : pointer(static_cast<void*>(val), [d = std::move(d)](void* vp) { if (d) d(static_cast<T*>(vp)); }) {}
+        pointer(T* val, std::nullptr_t) {
+            setup_control_block(val, detail::no_delete());
+        }
 
+        // Shares ownership with `other` (keeping its deleter); a view stays a view.
         template <typename U>
-        pointer(const pointer<U>& other) :
-            ptr_counter(nullptr),
-            value(other.value),
-            original_value(nullptr),
-            deleter(nullptr)
-        {}
+        pointer(const pointer<U>& other) : pointer(pointer<U>(other)) {}
 
+        // Deliberately not noexcept, unlike the typed pointer's moves: the typed
+        // pointer's deleter has to move into a new control block. If that
+        // allocation fails the result is null and `other` keeps its object.
         template <typename U>
-        pointer(pointer<U>&& other) noexcept :
-            ptr_counter(other.ptr_counter),
-            value(other.value),
-            original_value(other.original_value),
-            deleter(nullptr)
-        {
-            other.ptr_counter = nullptr;
-            other.value = nullptr;
-            other.original_value = nullptr;
-            // other.isArray = false; // No isArray in void spec
+        pointer(pointer<U>&& other) {
+            if (!other.ptr_counter) {
+                value = other.value;
+                other.value = nullptr;
+                other.original_value = nullptr;
+                return;
+            }
+            void* current = other.value;
+            detail::erased_owner_block<U>* block = new(std::nothrow) detail::erased_owner_block<U>(std::move(other));
+            if (block) {
+                ptr_counter = block;
+                value = current;
+                original_value = block->owner.original_value;
+            }
         }
 
 
         pointer(const pointer& other) :
             ptr_counter(other.ptr_counter),
             value(other.value),
-            original_value(other.original_value),
-            deleter(other.deleter)
+            original_value(other.original_value)
         {
             if (ptr_counter) {
-                ++(*ptr_counter);
+                ptr_counter->count.fetch_add(1, std::memory_order_relaxed);
             }
         }
 
         pointer(pointer&& other) noexcept :
             ptr_counter(other.ptr_counter),
             value(other.value),
-            original_value(other.original_value),
-            deleter(std::move(other.deleter))
+            original_value(other.original_value)
         {
             other.ptr_counter = nullptr;
             other.value = nullptr;
@@ -528,17 +718,43 @@ namespace em {
             return original_value;
         }
 
+        // The object as a T*, or nullptr if it was not stored as a T. Views
+        // (borrow) carry no type and always give nullptr.
+        template<typename T>
+        T* get() const {
+            const detail::erased_ops* table = ops();
+            if (!table || table->type != detail::type_id_of<T>()) {
+                return nullptr;
+            }
+            return static_cast<T*>(value);
+        }
+
+        // A pointer<T> sharing this control block, or a null one if the object
+        // was not stored as a T.
+        template<typename T>
+        pointer<T> cast() const {
+            pointer<T> result;
+            if (get<T>()) {
+                ptr_counter->count.fetch_add(1, std::memory_order_relaxed);
+                result.ptr_counter = ptr_counter;
+                result.value = static_cast<T*>(value);
+                result.original_value = static_cast<T*>(original_value);
+            }
+            return result;
+        }
+
+        // Only a sole owner can release the object. Otherwise, or if the block
+        // cannot give it up (e.g. it was slab-allocated), returns nullptr and
+        // keeps owning it.
         void* do_not_manage() {
-            void* released_ptr = original_value;
-            if (ptr_counter) {
-                --(*ptr_counter);
+            if (!ptr_counter || ptr_counter->count.load(std::memory_order_acquire) != 1) {
+                return nullptr;
+            }
+            void* released_ptr = ops()->release(ptr_counter);
+            if (released_ptr) {
                 ptr_counter = nullptr;
                 value = nullptr;
                 original_value = nullptr;
-                deleter = nullptr;
-            }
-            else {
-                released_ptr = nullptr;
             }
             return released_ptr;
         }
@@ -549,11 +765,7 @@ namespace em {
         }
 
         int use_count() const {
-            return ptr_counter ? *ptr_counter : 0;
-        }
-
-        std::function<void(void*)> get_deleter() const {
-            return deleter;
+            return ptr_counter ? ptr_counter->count.load(std::memory_order_acquire) : 0;
         }
 
         void swap(pointer& other) noexcept {
@@ -561,7 +773,6 @@ namespace em {
             swap(ptr_counter, other.ptr_counter);
             swap(value, other.value);
             swap(original_value, other.original_value);
-            swap(deleter, other.deleter);
         }
 
     };
@@ -576,6 +787,35 @@ namespace em {
         lhs.swap(rhs);
     }
 
+    // Non-owning view of `val`: behaves like any em::pointer but never counts or
+    // deletes, like the results of pointer arithmetic. Lets code that only has a
+    // T* look up or compare against owning pointers without adopting the object.
+    template<typename T>
+    pointer<T> borrow(T* val) {
+        pointer<T> view;
+        view.value = val;
+        return view;
+    }
+
+    namespace detail {
+
+        // Lets the library's own factories build pointers around a ref_block they
+        // placed themselves.
+        struct pointer_access {
+            // Takes over one reference held on `block`, which must dispose of `val`.
+            template<typename T>
+            static pointer<T> adopt(ref_block* block, T* val) {
+                static_assert(!std::is_void<T>::value, "pointer<void> needs an erased_block");
+                pointer<T> result;
+                result.ptr_counter = block;
+                result.value = val;
+                result.original_value = val;
+                return result;
+            }
+        };
+
+    } // namespace detail
+
     template<typename T, typename U>
     bool operator==(const pointer<T>& lhs, const pointer<U>& rhs) {
         return lhs.get_raw_ptr() == rhs.get_raw_ptr();
@@ -668,4 +908,20 @@ namespace em {
     }
 
 }
+
+namespace std {
+
+    // Hashes the current address, matching operator== on em::pointer.
+    template<typename T>
+    struct hash<em::pointer<T>> {
+        std::size_t operator()(const em::pointer<T>& p) const noexcept {
+            return std::hash<typename em::pointer<T>::pointer_type>()(p.get_raw_ptr());
+        }
+    };
+
+}
+#if defined(EM_POINTER_PROFILING)
+#include "EMPointerProfiler.h"
+#endif
+
 #endif // !EM_POINTER
@@ -0,0 +1,113 @@
+#ifndef EM_POINTER_BATCH
+#define EM_POINTER_BATCH
+
+#include "EMPointer.h"
+#include <atomic>
+#include <cstddef>
+#include <new>
+#include <utility>
+#include <vector>
+
+// Many independently owned objects from one allocation.
+//
+// em::make_pointers<T>(n, args...) constructs n objects, each next to its own
+// reference count, in a single slab and returns n ordinary em::pointer<T>.
+// Every object is destroyed as soon as its own last pointer goes away; the slab
+// itself is freed when the last object in it has been destroyed. Walking the
+// batch in order touches consecutive memory, as with an array.
+
+namespace em {
+
+    namespace detail {
+
+        struct slab_header {
+            std::atomic<std::size_t> live;
+        };
+
+        template<typename T>
+        struct slab_entry {
+            ref_block block;
+            slab_header* slab;
+            alignas(T) unsigned char storage[sizeof(T)];
+
+            T* value() {
+                return reinterpret_cast<T*>(storage);
+            }
+
+            static void dispose(ref_block* released) {
+                // `block` is the first member, so its address is the entry's.
+                slab_entry* entry = reinterpret_cast<slab_entry*>(released);
+                slab_header* owner = entry->slab;
+                try {
+                    entry->value()->~T();
+                }
+                catch (...) { /* Cannot throw */ }
+                entry->block.~ref_block();
+                if (owner->live.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                    owner->~slab_header();
+                    ::operator delete(owner);
+                }
+            }
+        };
+
+        template<typename T>
+        std::size_t slab_entries_offset() {
+            const std::size_t align = alignof(slab_entry<T>);
+            return (sizeof(slab_header) + align - 1) / align * align;
+        }
+
+    } // namespace detail
+
+    // Returns an empty vector if the slab cannot be allocated or a constructor throws.
+    template<typename T, typename... Args>
+    std::vector<pointer<T>> make_pointers(std::size_t count, const Args&... args) {
+        static_assert(alignof(detail::slab_entry<T>) <= alignof(std::max_align_t),
+            "make_pointers does not support over-aligned types");
+        using entry = detail::slab_entry<T>;
+
+        std::vector<pointer<T>> result;
+        if (count == 0) {
+            return result;
+        }
+        try {
+            result.reserve(count);
+        }
+        catch (...) {
+            return result;
+        }
+
+        const std::size_t offset = detail::slab_entries_offset<T>();
+        void* memory = ::operator new(offset + sizeof(entry) * count, std::nothrow);
+        if (!memory) {
+            return result;
+        }
+        detail::slab_header* slab = new(memory) detail::slab_header;
+        slab->live.store(count, std::memory_order_relaxed);
+        entry* entries = reinterpret_cast<entry*>(static_cast<unsigned char*>(memory) + offset);
+
+        std::size_t built = 0;
+        try {
+            for (; built < count; ++built) {
+                new(entries[built].storage) T(args...);
+            }
+        }
+        catch (...) {
+            while (built > 0) {
+                --built;
+                entries[built].value()->~T();
+            }
+            slab->~slab_header();
+            ::operator delete(memory);
+            return result;
+        }
+
+        for (std::size_t i = 0; i < count; ++i) {
+            new(&entries[i].block) detail::ref_block(1, &entry::dispose);
+            entries[i].slab = slab;
+            result.push_back(detail::pointer_access::adopt(&entries[i].block, entries[i].value()));
+        }
+        return result;
+    }
+
+}
+#endif // !EM_POINTER_BATCH
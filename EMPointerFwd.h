@@ -0,0 +1,64 @@
+#ifndef EM_POINTER_FWD
+#define EM_POINTER_FWD
+
+#include <cstdint>
+
+// Forward declarations of every em type, for headers that only name them.
+//
+// Including this costs next to nothing; include the defining header (noted
+// next to each group) where the complete type is needed. Default template
+// arguments live here only, and the defining headers include this file.
+
+namespace em {
+
+    // EMPointer.h
+    template<typename T> class pointer;
+
+    // EMCowPointer.h
+    template<typename T> class cow_pointer;
+
+    // EMOffsetPointer.h
+    template<typename T> class offset_pointer;
+    class offset_arena;
+
+    // EMPointerMap.h
+    struct pointer_hash;
+    struct pointer_equal;
+    template<typename T, typename V> class pointer_map;
+
+    // EMSlotMap.h
+    template<typename T, typename Id = std::uint64_t> class handle;
+    template<typename T, typename Id = std::uint64_t> class shared_handle;
+    template<typename T, typename Id = std::uint64_t> class slot_map;
+
+    // EMCollectablePointer.h
+    template<typename T> struct trace;
+    template<typename T> class collectable_pointer;
+    class cycle_collector;
+
+    // EMLazyPointer.h
+    template<typename T> class lazy_pointer;
+
+    // EMTaggedPointer.h
+    template<typename T, unsigned LowBits, unsigned HighBits = 0> class tagged_pointer;
+    template<typename T, unsigned LowBits, unsigned HighBits = 0> class tagged_shared_pointer;
+
+    // EMPointerSimd.h
+    enum class simd_level : int;
+
+    // EMChannel.h
+    enum class channel_mode : int;
+    template<typename T> class channel;
+
+    // EMPersistent.h
+    template<typename T> class pvector;
+    template<typename K, typename V> class pmap;
+
+    // EMPointerProfiler.h
+    class allocation_profiler;
+
+    // EMIoBufferPool.h (POSIX)
+    class io_buffer_pool;
+
+}
+#endif // !EM_POINTER_FWD
@@ -0,0 +1,298 @@
+#ifndef EM_POINTER_MAP
+#define EM_POINTER_MAP
+
+#include "EMPointer.h"
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <utility>
+
+// Lookup by address without building temporary owning pointers.
+//
+// em::pointer_hash / em::pointer_equal are transparent functors that accept
+// T*, em::pointer<T> and borrowed views (em::borrow(raw)), so a
+// std::unordered_map<em::pointer<T>, V, em::pointer_hash, em::pointer_equal>
+// can be searched with a raw pointer (C++20 heterogeneous lookup).
+//
+// em::pointer_map<T, V> is an open-addressing table keyed on the raw address.
+// Probing walks a dense array of addresses only; the owning key and the value
+// sit in a parallel array that is touched once the address matches. Lookups
+// take a const T*, and em::pointer<T> converts to that implicitly, so neither
+// form allocates.
+
+namespace em {
+
+    namespace detail {
+
+        // Addresses are aligned, so mix the bits before using them as a hash.
+        inline std::size_t hash_address(const void* address) noexcept {
+            std::uint64_t x = static_cast<std::uint64_t>(reinterpret_cast<std::uintptr_t>(address));
+            x ^= x >> 33;
+            x *= 0xff51afd7ed558ccdull;
+            x ^= x >> 33;
+            x *= 0xc4ceb9fe1a85ec53ull;
+            x ^= x >> 33;
+            return static_cast<std::size_t>(x);
+        }
+
+    } // namespace detail
+
+    struct pointer_hash {
+        using is_transparent = void;
+
+        template<typename T>
+        std::size_t operator()(const T* address) const noexcept {
+            return detail::hash_address(address);
+        }
+
+        template<typename T>
+        std::size_t operator()(const pointer<T>& p) const noexcept {
+            return detail::hash_address(p.get_raw_ptr());
+        }
+    };
+
+    struct pointer_equal {
+        using is_transparent = void;
+
+        template<typename A, typename B>
+        bool operator()(const A& lhs, const B& rhs) const noexcept {
+            return address_of(lhs) == address_of(rhs);
+        }
+
+    private:
+        template<typename T>
+        static const void* address_of(const T* address) noexcept {
+            return address;
+        }
+
+        template<typename T>
+        static const void* address_of(T* address) noexcept {
+            return address;
+        }
+
+        template<typename T>
+        static const void* address_of(const pointer<T>& p) noexcept {
+            return p.get_raw_ptr();
+        }
+    };
+
+    template<typename T, typename V>
+    class pointer_map {
+    private:
+        using address_type = const T*;
+
+        struct entry {
+            pointer<T> key;
+            V value;
+        };
+
+        address_type* addresses = nullptr;  // nullptr marks an empty slot
+        entry* entries = nullptr;           // constructed only where addresses[i] != nullptr
+        std::size_t slot_count = 0;         // zero or a power of two
+        std::size_t element_count = 0;
+
+        std::size_t home(address_type address) const {
+            return detail::hash_address(address) & (slot_count - 1);
+        }
+
+        std::size_t locate(address_type address) const {
+            if (!address || slot_count == 0) {
+                return slot_count;
+            }
+            for (std::size_t i = home(address);; i = (i + 1) & (slot_count - 1)) {
+                if (addresses[i] == address) return i;
+                if (!addresses[i]) return slot_count;
+            }
+        }
+
+        void release_storage() {
+            for (std::size_t i = 0; i < slot_count; ++i) {
+                if (addresses[i]) {
+                    entries[i].~entry();
+                }
+            }
+            delete[] addresses;
+            ::operator delete(entries);
+            addresses = nullptr;
+            entries = nullptr;
+            slot_count = 0;
+            element_count = 0;
+        }
+
+        void rehash(std::size_t new_slot_count) {
+            address_type* old_addresses = addresses;
+            entry* old_entries = entries;
+            std::size_t old_slot_count = slot_count;
+
+            addresses = new address_type[new_slot_count]();
+            entries = static_cast<entry*>(::operator new(sizeof(entry) * new_slot_count));
+            slot_count = new_slot_count;
+
+            for (std::size_t i = 0; i < old_slot_count; ++i) {
+                if (old_addresses[i]) {
+                    std::size_t j = home(old_addresses[i]);
+                    while (addresses[j]) j = (j + 1) & (slot_count - 1);
+                    addresses[j] = old_addresses[i];
+                    new(&entries[j]) entry(std::move(old_entries[i]));
+                    old_entries[i].~entry();
+                }
+            }
+            delete[] old_addresses;
+            ::operator delete(old_entries);
+        }
+
+    public:
+        pointer_map() = default;
+
+        pointer_map(const pointer_map& other) {
+            reserve(other.element_count);
+            other.for_each([this](const pointer<T>& key, const V& value) { insert(key, value); });
+        }
+
+        pointer_map(pointer_map&& other) noexcept :
+            addresses(other.addresses),
+            entries(other.entries),
+            slot_count(other.slot_count),
+            element_count(other.element_count)
+        {
+            other.addresses = nullptr;
+            other.entries = nullptr;
+            other.slot_count = 0;
+            other.element_count = 0;
+        }
+
+        ~pointer_map() {
+            release_storage();
+        }
+
+        pointer_map& operator=(const pointer_map& other) {
+            if (this != &other) {
+                pointer_map temp(other);
+                swap(temp);
+            }
+            return *this;
+        }
+
+        pointer_map& operator=(pointer_map&& other) noexcept {
+            if (this != &other) {
+                pointer_map temp(std::move(other));
+                swap(temp);
+            }
+            return *this;
+        }
+
+        void swap(pointer_map& other) noexcept {
+            using std::swap;
+            swap(addresses, other.addresses);
+            swap(entries, other.entries);
+            swap(slot_count, other.slot_count);
+            swap(element_count, other.element_count);
+        }
+
+        std::size_t size() const {
+            return element_count;
+        }
+
+        bool empty() const {
+            return element_count == 0;
+        }
+
+        void clear() {
+            release_storage();
+        }
+
+        // Makes room for `count` elements at a load factor of at most 3/4.
+        void reserve(std::size_t count) {
+            std::size_t wanted = 8;
+            while (wanted * 3 < count * 4) wanted *= 2;
+            if (wanted > slot_count) {
+                rehash(wanted);
+            }
+        }
+
+        // Adds `key` -> `value` unless the address is already present. Returns the
+        // stored value and whether it was inserted. Null keys are rejected.
+        std::pair<V*, bool> insert(const pointer<T>& key, V value) {
+            address_type address = key.get_raw_ptr();
+            if (!address) {
+                return std::pair<V*, bool>(nullptr, false);
+            }
+            std::size_t found = locate(address);
+            if (found != slot_count) {
+                return std::pair<V*, bool>(&entries[found].value, false);
+            }
+            reserve(element_count + 1);
+            std::size_t i = home(address);
+            while (addresses[i]) i = (i + 1) & (slot_count - 1);
+            new(&entries[i]) entry{ key, std::move(value) };
+            addresses[i] = address;
+            ++element_count;
+            return std::pair<V*, bool>(&entries[i].value, true);
+        }
+
+        V* find(const T* address) {
+            std::size_t i = locate(address);
+            return i == slot_count ? nullptr : &entries[i].value;
+        }
+
+        const V* find(const T* address) const {
+            std::size_t i = locate(address);
+            return i == slot_count ? nullptr : &entries[i].value;
+        }
+
+        // The owning pointer stored for `address`, or null when absent.
+        pointer<T> find_key(const T* address) const {
+            std::size_t i = locate(address);
+            return i == slot_count ? pointer<T>() : entries[i].key;
+        }
+
+        bool contains(const T* address) const {
+            return locate(address) != slot_count;
+        }
+
+        bool erase(const T* address) {
+            std::size_t hole = locate(address);
+            if (hole == slot_count) {
+                return false;
+            }
+            entries[hole].~entry();
+            addresses[hole] = nullptr;
+            --element_count;
+
+            // Backward-shift deletion keeps every probe chain contiguous without tombstones.
+            for (std::size_t i = (hole + 1) & (slot_count - 1); addresses[i]; i = (i + 1) & (slot_count - 1)) {
+                std::size_t want = home(addresses[i]);
+                bool movable = (hole <= i) ? (want <= hole || want > i) : (want <= hole && want > i);
+                if (movable) {
+                    addresses[hole] = addresses[i];
+                    new(&entries[hole]) entry(std::move(entries[i]));
+                    entries[i].~entry();
+                    addresses[i] = nullptr;
+                    hole = i;
+                }
+            }
+            return true;
+        }
+
+        template<typename F>
+        void for_each(F f) {
+            for (std::size_t i = 0; i < slot_count; ++i) {
+                if (addresses[i]) f(static_cast<const pointer<T>&>(entries[i].key), entries[i].value);
+            }
+        }
+
+        template<typename F>
+        void for_each(F f) const {
+            for (std::size_t i = 0; i < slot_count; ++i) {
+                if (addresses[i]) f(static_cast<const pointer<T>&>(entries[i].key), static_cast<const V&>(entries[i].value));
+            }
+        }
+    };
+
+    template<typename T, typename V>
+    void swap(pointer_map<T, V>& lhs, pointer_map<T, V>& rhs) noexcept {
+        lhs.swap(rhs);
+    }
+
+}
+#endif // !EM_POINTER_MAP
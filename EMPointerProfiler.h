@@ -0,0 +1,384 @@
+#ifndef EM_POINTER_PROFILER
+#define EM_POINTER_PROFILER
+
+#include "EMPointer.h"
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <csignal>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#if !defined(__GLIBC__) && !defined(__APPLE__)
+#error "EMPointerProfiler.h needs backtrace() from <execinfo.h> (glibc or macOS)"
+#endif
+
+#include <cxxabi.h>
+#include <execinfo.h>
+
+// Sampling profiler for memory owned by em::pointer.
+//
+// Compile every translation unit with EM_POINTER_PROFILING defined (it changes
+// the control block layout); without it this header still compiles and the
+// dumps are simply empty. A pointer<T> built from new'd memory, a pointer<T>
+// array, or a custom deleter then counts its bytes down from a per-thread
+// budget. The allocation that crosses the budget gets sampled: its stack is
+// captured with backtrace() and the sample is hung off the control block.
+// The block's release drops the sample. Intervals between samples are drawn
+// from an exponential distribution (mean: sample_interval()), so every byte
+// has the same chance of being sampled. An unsampled allocation costs one
+// thread-local subtraction and a branch, its release one branch. Without the
+// macro there are no hooks at all.
+//
+// Dumps list the memory sampled allocations still retain, per call stack:
+//     write_pprof   legacy gperftools heap profile ("heap_v2"); pprof scales it up
+//     write_folded  "outer;...;inner bytes" lines, already scaled, for flamegraph.pl
+// dump_on_signal(SIGUSR2, "/tmp/app") writes /tmp/app.<n>.heap and
+// /tmp/app.<n>.folded from a watcher thread each time the signal arrives.
+// Function names need -rdynamic (or a pprof run against the binary).
+//
+// pointer<void> and blocks made by library factories (make_pointers,
+// pointer_access) are not sampled.
+
+namespace em {
+
+    namespace detail {
+
+        struct profile_site {
+            std::vector<void*> frames;  // innermost first
+            std::size_t count = 0;      // live sampled allocations
+            std::size_t bytes = 0;      // their requested bytes
+            double scaled_bytes = 0;    // estimate of all live bytes from this site
+        };
+
+        struct profile_sample {
+            profile_site* site;
+            std::size_t bytes;
+            double scaled_bytes;
+        };
+
+        struct profile_thread_state {
+            std::int64_t countdown;
+            std::uint64_t random;
+            bool seeded;
+        };
+
+        // Constant-initialised, so access needs no guard.
+        inline profile_thread_state& profile_thread() {
+            static thread_local profile_thread_state state = { 0, 0, false };
+            return state;
+        }
+
+        struct profile_frames_hash {
+            std::size_t operator()(const std::vector<void*>& frames) const {
+                std::size_t h = 0;
+                for (void* frame : frames) {
+                    h = h * 1000003u ^ reinterpret_cast<std::uintptr_t>(frame);
+                }
+                return h;
+            }
+        };
+
+    } // namespace detail
+
+    class allocation_profiler {
+    private:
+        static constexpr std::size_t default_interval = 512 * 1024;
+        static constexpr std::int64_t disabled_recheck = 64 * 1024 * 1024;
+
+        std::atomic<std::size_t> interval{ default_interval };
+        std::mutex lock;
+        std::unordered_map<std::vector<void*>, detail::profile_site*, detail::profile_frames_hash> sites;
+
+        std::atomic<bool> dump_requested{ false };
+        bool watching = false;
+        std::string dump_prefix;
+        unsigned dump_sequence = 0;
+
+        allocation_profiler() = default;
+
+        static double exponential(detail::profile_thread_state& t, double mean) {
+            // xorshift64*, uniform in (0, 1]
+            t.random ^= t.random >> 12;
+            t.random ^= t.random << 25;
+            t.random ^= t.random >> 27;
+            double u = static_cast<double>((t.random * 0x2545f4914f6cdd1dull) >> 11) * (1.0 / 9007199254740992.0);
+            return -std::log(1.0 - u) * mean;
+        }
+
+#if defined(EM_POINTER_PROFILING)
+        void record(detail::ref_block* block, std::size_t bytes, double scaled, void** frames, int depth) {
+            try {
+                std::lock_guard<std::mutex> guard(lock);
+                std::vector<void*> key(frames, frames + depth);
+                detail::profile_site*& site = sites[key];
+                if (!site) {
+                    site = new detail::profile_site;
+                    site->frames = std::move(key);
+                }
+                block->sample = new detail::profile_sample{ site, bytes, scaled };
+                site->count += 1;
+                site->bytes += bytes;
+                site->scaled_bytes += scaled;
+            }
+            catch (...) { /* Not sampled */ }
+        }
+
+        void forget(detail::ref_block* block) {
+            std::lock_guard<std::mutex> guard(lock);
+            detail::profile_sample* sample = block->sample;
+            block->sample = nullptr;
+            sample->site->count -= 1;
+            sample->site->bytes -= sample->bytes;
+            sample->site->scaled_bytes -= sample->scaled_bytes;
+            delete sample;
+        }
+#endif
+
+        // Copies the live sites so nothing is symbolised or written under the lock.
+        std::vector<detail::profile_site> snapshot() {
+            std::vector<detail::profile_site> live;
+            std::lock_guard<std::mutex> guard(lock);
+            for (const auto& entry : sites) {
+                if (entry.second->count > 0) {
+                    live.push_back(*entry.second);
+                }
+            }
+            return live;
+        }
+
+        static std::string frame_name(const char* symbol) {
+            // glibc: "binary(mangled+0x1f) [0x...]"; macOS: "3 binary 0x... mangled + 31"
+            std::string text(symbol);
+            std::string mangled;
+            std::size_t open = text.find('(');
+            std::size_t plus = text.find('+', open == std::string::npos ? 0 : open);
+            if (open != std::string::npos && plus != std::string::npos && plus > open + 1) {
+                mangled = text.substr(open + 1, plus - open - 1);
+            }
+            else if (open == std::string::npos) {
+                std::size_t end = text.rfind(" + ");
+                std::size_t start = end == std::string::npos ? end : text.rfind(' ', end - 1);
+                if (start != std::string::npos) {
+                    mangled = text.substr(start + 1, end - start - 1);
+                }
+            }
+            std::string name = text;
+            if (!mangled.empty()) {
+                int status = 0;
+                char* demangled = abi::__cxa_demangle(mangled.c_str(), nullptr, nullptr, &status);
+                name = (status == 0 && demangled) ? demangled : mangled;
+                std::free(demangled);
+            }
+            for (char& c : name) {
+                if (c == ';') c = ':';
+            }
+            return name;
+        }
+
+        void watch() {
+            for (;;) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(100));
+                if (dump_requested.exchange(false, std::memory_order_acquire)) {
+                    std::string prefix;
+                    {
+                        std::lock_guard<std::mutex> guard(lock);
+                        prefix = dump_prefix;
+                    }
+                    std::string base = prefix + "." + std::to_string(dump_sequence++);
+                    dump_pprof((base + ".heap").c_str());
+                    dump_folded((base + ".folded").c_str());
+                }
+            }
+        }
+
+#if defined(EM_POINTER_PROFILING)
+        // Out of line, so the hot path stays small and the frame it skips is its own.
+#if defined(__GNUC__)
+        __attribute__((noinline))
+#endif
+        static void take_sample(detail::ref_block* block, std::size_t bytes, detail::profile_thread_state& t) {
+            allocation_profiler& profiler = global();
+            std::size_t mean_interval = profiler.sample_interval();
+            if (!t.seeded) {
+                t.random = reinterpret_cast<std::uintptr_t>(&t) ^
+                    static_cast<std::uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count()) ^
+                    0x9e3779b97f4a7c15ull;
+                t.seeded = true;
+                // The thread's first allocation only starts the countdown: sampling
+                // it outright would give every short-lived thread a full interval's
+                // weight for a few bytes.
+                if (mean_interval != 0) {
+                    t.countdown = static_cast<std::int64_t>(exponential(t, static_cast<double>(mean_interval))) + 1 -
+                        static_cast<std::int64_t>(bytes);
+                    if (t.countdown > 0) {
+                        return;
+                    }
+                }
+            }
+            if (mean_interval == 0) {
+                t.countdown = disabled_recheck;
+                return;
+            }
+            double mean = static_cast<double>(mean_interval);
+            t.countdown = static_cast<std::int64_t>(exponential(t, mean)) + 1;
+
+            // One sample stands for every byte allocated since the previous one.
+            double size = static_cast<double>(bytes ? bytes : 1);
+            double scaled = size / (1.0 - std::exp(-size / mean));
+
+            void* frames[64];
+            int depth = ::backtrace(frames, 64);
+            if (depth > 1) {
+                profiler.record(block, bytes, scaled, frames + 1, depth - 1);
+            }
+        }
+
+        friend void detail::profile_allocation(detail::ref_block*, std::size_t);
+        friend void detail::profile_release(detail::ref_block*);
+#endif
+
+    public:
+        allocation_profiler(const allocation_profiler&) = delete;
+        allocation_profiler& operator=(const allocation_profiler&) = delete;
+
+        // Never destroyed: pointers may still be released during static destruction.
+        static allocation_profiler& global() {
+            static allocation_profiler* instance = new allocation_profiler;
+            return *instance;
+        }
+
+        // Mean number of bytes between samples; 0 stops sampling.
+        void set_sample_interval(std::size_t bytes) {
+            interval.store(bytes, std::memory_order_relaxed);
+        }
+
+        std::size_t sample_interval() const {
+            return interval.load(std::memory_order_relaxed);
+        }
+
+        // Estimated bytes retained by all em::pointer allocations right now.
+        std::size_t retained_bytes() {
+            std::lock_guard<std::mutex> guard(lock);
+            double total = 0;
+            for (const auto& entry : sites) {
+                total += entry.second->scaled_bytes;
+            }
+            return total > 0 ? static_cast<std::size_t>(total) : 0;
+        }
+
+        bool write_pprof(std::FILE* out) {
+            std::vector<detail::profile_site> live = snapshot();
+            std::size_t count = 0;
+            std::size_t bytes = 0;
+            for (const detail::profile_site& site : live) {
+                count += site.count;
+                bytes += site.bytes;
+            }
+            std::fprintf(out, "heap profile: %zu: %zu [%zu: %zu] @ heap_v2/%zu\n",
+                count, bytes, count, bytes, sample_interval());
+            for (const detail::profile_site& site : live) {
+                std::fprintf(out, "%zu: %zu [%zu: %zu] @", site.count, site.bytes, site.count, site.bytes);
+                for (void* frame : site.frames) {
+                    std::fprintf(out, " %p", frame);
+                }
+                std::fputc('\n', out);
+            }
+            std::fputs("\nMAPPED_LIBRARIES:\n", out);
+            if (std::FILE* maps = std::fopen("/proc/self/maps", "r")) {
+                char buffer[4096];
+                std::size_t got;
+                while ((got = std::fread(buffer, 1, sizeof(buffer), maps)) > 0) {
+                    std::fwrite(buffer, 1, got, out);
+                }
+                std::fclose(maps);
+            }
+            return std::ferror(out) == 0;
+        }
+
+        bool write_folded(std::FILE* out) {
+            std::vector<detail::profile_site> live = snapshot();
+            for (const detail::profile_site& site : live) {
+                int depth = static_cast<int>(site.frames.size());
+                char** symbols = ::backtrace_symbols(const_cast<void**>(site.frames.data()), depth);
+                for (int i = depth - 1; i >= 0; --i) {
+                    std::string name = symbols ? frame_name(symbols[i]) : std::to_string(reinterpret_cast<std::uintptr_t>(site.frames[i]));
+                    std::fprintf(out, "%s%s", name.c_str(), i > 0 ? ";" : "");
+                }
+                std::fprintf(out, " %.0f\n", site.scaled_bytes);
+                std::free(symbols);
+            }
+            return std::ferror(out) == 0;
+        }
+
+        bool dump_pprof(const char* path) {
+            std::FILE* out = std::fopen(path, "w");
+            if (!out) {
+                return false;
+            }
+            bool written = write_pprof(out);
+            return std::fclose(out) == 0 && written;
+        }
+
+        bool dump_folded(const char* path) {
+            std::FILE* out = std::fopen(path, "w");
+            if (!out) {
+                return false;
+            }
+            bool written = write_folded(out);
+            return std::fclose(out) == 0 && written;
+        }
+
+        // Dumps both formats to <prefix>.<n>.heap / .folded whenever `signo`
+        // arrives. The handler only sets a flag; a watcher thread writes the files.
+        bool dump_on_signal(int signo, const std::string& prefix) {
+            {
+                std::lock_guard<std::mutex> guard(lock);
+                dump_prefix = prefix;
+                if (!watching) {
+                    try {
+                        std::thread(&allocation_profiler::watch, this).detach();
+                    }
+                    catch (...) {
+                        return false;
+                    }
+                    watching = true;
+                }
+            }
+            struct sigaction action;
+            std::memset(&action, 0, sizeof(action));
+            action.sa_handler = [](int) { global().dump_requested.store(true, std::memory_order_release); };
+            sigemptyset(&action.sa_mask);
+            action.sa_flags = SA_RESTART;
+            return ::sigaction(signo, &action, nullptr) == 0;
+        }
+    };
+
+#if defined(EM_POINTER_PROFILING)
+    namespace detail {
+
+        inline void profile_allocation(ref_block* block, std::size_t bytes) {
+            profile_thread_state& t = profile_thread();
+            t.countdown -= static_cast<std::int64_t>(bytes);
+            if (t.countdown <= 0) {
+                allocation_profiler::take_sample(block, bytes, t);
+            }
+        }
+
+        inline void profile_release(ref_block* block) {
+            allocation_profiler::global().forget(block);
+        }
+
+    } // namespace detail
+#endif // EM_POINTER_PROFILING
+
+}
+#endif // !EM_POINTER_PROFILER
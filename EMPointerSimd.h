@@ -0,0 +1,776 @@
+#ifndef EM_POINTER_SIMD
+#define EM_POINTER_SIMD
+
+#include "EMPointer.h"
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define EM_SIMD_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#define EM_SIMD_TARGET(isa)
+#else
+#define EM_SIMD_TARGET(isa) __attribute__((target(isa)))
+#endif
+#endif
+
+// Bulk kernels for array-mode em::pointer buffers.
+//
+// Every kernel operates on the *current* pointer (get_raw_ptr()), so it honours
+// pointer arithmetic exactly like operator[] does. em::pointer does not record
+// the length of an array allocation, so the element count is always passed in.
+//
+// The instruction set is chosen once at runtime (AVX-512BW, AVX2, SSE2, scalar).
+// set_simd_level() can lower it, which is how the kernels are checked against
+// the scalar path. Floating-point sums are reassociated across vector lanes and
+// may differ from a sequential sum in the last bits.
+
+namespace em {
+
+    enum class simd_level : int {
+        scalar = 0,
+        sse2 = 1,
+        avx2 = 2,
+        avx512 = 3
+    };
+
+    namespace detail {
+
+        struct simd_kernels {
+            void (*fill)(unsigned char* dst, std::size_t bytes, std::uint64_t pattern);
+            void (*copy)(unsigned char* dst, const unsigned char* src, std::size_t bytes);
+            bool (*equal)(const unsigned char* lhs, const unsigned char* rhs, std::size_t bytes);
+            std::size_t (*find8)(const unsigned char* data, std::size_t count, std::uint64_t needle);
+            std::size_t (*find16)(const unsigned char* data, std::size_t count, std::uint64_t needle);
+            std::size_t (*find32)(const unsigned char* data, std::size_t count, std::uint64_t needle);
+            std::size_t (*find64)(const unsigned char* data, std::size_t count, std::uint64_t needle);
+            std::uint32_t (*sum_u32)(const unsigned char* data, std::size_t count);
+            std::uint64_t (*sum_u64)(const unsigned char* data, std::size_t count);
+            float (*sum_f32)(const unsigned char* data, std::size_t count);
+            double (*sum_f64)(const unsigned char* data, std::size_t count);
+        };
+
+        inline unsigned ctz32(std::uint32_t mask) {
+#if defined(_MSC_VER) && !defined(__clang__)
+            unsigned long index;
+            _BitScanForward(&index, mask);
+            return static_cast<unsigned>(index);
+#else
+            return static_cast<unsigned>(__builtin_ctz(mask));
+#endif
+        }
+
+        inline unsigned ctz64(std::uint64_t mask) {
+            std::uint32_t low = static_cast<std::uint32_t>(mask);
+            return low ? ctz32(low) : 32u + ctz32(static_cast<std::uint32_t>(mask >> 32));
+        }
+
+        // --- Scalar kernels (also used for every tail) ---
+
+        inline void fill_scalar(unsigned char* dst, std::size_t bytes, std::uint64_t pattern) {
+            unsigned char block[8];
+            std::memcpy(block, &pattern, 8);
+            std::size_t i = 0;
+            for (; i + 8 <= bytes; i += 8) {
+                std::memcpy(dst + i, block, 8);
+            }
+            for (std::size_t j = 0; i < bytes; ++i, ++j) {
+                dst[i] = block[j];
+            }
+        }
+
+        inline void copy_scalar(unsigned char* dst, const unsigned char* src, std::size_t bytes) {
+            if (bytes) {
+                std::memcpy(dst, src, bytes);
+            }
+        }
+
+        inline bool equal_scalar(const unsigned char* lhs, const unsigned char* rhs, std::size_t bytes) {
+            return bytes == 0 || std::memcmp(lhs, rhs, bytes) == 0;
+        }
+
+        template<typename Word>
+        std::size_t find_scalar(const unsigned char* data, std::size_t count, std::uint64_t needle) {
+            Word target = static_cast<Word>(needle);
+            for (std::size_t i = 0; i < count; ++i) {
+                Word current;
+                std::memcpy(&current, data + i * sizeof(Word), sizeof(Word));
+                if (current == target) {
+                    return i;
+                }
+            }
+            return count;
+        }
+
+        template<typename Acc>
+        Acc sum_scalar(const unsigned char* data, std::size_t count) {
+            Acc total = 0;
+            for (std::size_t i = 0; i < count; ++i) {
+                Acc current;
+                std::memcpy(&current, data + i * sizeof(Acc), sizeof(Acc));
+                total += current;
+            }
+            return total;
+        }
+
+        inline const simd_kernels& scalar_kernels() {
+            static const simd_kernels table = {
+                &fill_scalar,
+                &copy_scalar,
+                &equal_scalar,
+                &find_scalar<std::uint8_t>,
+                &find_scalar<std::uint16_t>,
+                &find_scalar<std::uint32_t>,
+                &find_scalar<std::uint64_t>,
+                &sum_scalar<std::uint32_t>,
+                &sum_scalar<std::uint64_t>,
+                &sum_scalar<float>,
+                &sum_scalar<double>
+            };
+            return table;
+        }
+
+#ifdef EM_SIMD_X86
+
+        // --- SSE2 ---
+
+        EM_SIMD_TARGET("sse2")
+        inline void fill_sse2(unsigned char* dst, std::size_t bytes, std::uint64_t pattern) {
+            const __m128i v = _mm_set1_epi64x(static_cast<long long>(pattern));
+            std::size_t i = 0;
+            for (; i + 16 <= bytes; i += 16) {
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), v);
+            }
+            fill_scalar(dst + i, bytes - i, pattern);
+        }
+
+        EM_SIMD_TARGET("sse2")
+        inline void copy_sse2(unsigned char* dst, const unsigned char* src, std::size_t bytes) {
+            std::size_t i = 0;
+            for (; i + 16 <= bytes; i += 16) {
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i),
+                    _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i)));
+            }
+            copy_scalar(dst + i, src + i, bytes - i);
+        }
+
+        EM_SIMD_TARGET("sse2")
+        inline bool equal_sse2(const unsigned char* lhs, const unsigned char* rhs, std::size_t bytes) {
+            std::size_t i = 0;
+            for (; i + 16 <= bytes; i += 16) {
+                __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(lhs + i));
+                __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rhs + i));
+                if (_mm_movemask_epi8(_mm_cmpeq_epi8(a, b)) != 0xFFFF) {
+                    return false;
+                }
+            }
+            return equal_scalar(lhs + i, rhs + i, bytes - i);
+        }
+
+        EM_SIMD_TARGET("sse2")
+        inline __m128i cmpeq_sse2(__m128i a, __m128i b, std::size_t width) {
+            switch (width) {
+            case 1: return _mm_cmpeq_epi8(a, b);
+            case 2: return _mm_cmpeq_epi16(a, b);
+            case 4: return _mm_cmpeq_epi32(a, b);
+            default: {
+                // SSE2 has no 64-bit compare: both 32-bit halves must match.
+                __m128i halves = _mm_cmpeq_epi32(a, b);
+                return _mm_and_si128(halves, _mm_shuffle_epi32(halves, 0xB1));
+            }
+            }
+        }
+
+        template<typename Word>
+        EM_SIMD_TARGET("sse2")
+        std::size_t find_sse2(const unsigned char* data, std::size_t count, std::uint64_t needle) {
+            const std::size_t per_vec = 16 / sizeof(Word);
+            __m128i target;
+            switch (sizeof(Word)) {
+            case 1: target = _mm_set1_epi8(static_cast<char>(needle)); break;
+            case 2: target = _mm_set1_epi16(static_cast<short>(needle)); break;
+            case 4: target = _mm_set1_epi32(static_cast<int>(needle)); break;
+            default: target = _mm_set1_epi64x(static_cast<long long>(needle)); break;
+            }
+            std::size_t i = 0;
+            for (; i + per_vec <= count; i += per_vec) {
+                __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i * sizeof(Word)));
+                int mask = _mm_movemask_epi8(cmpeq_sse2(v, target, sizeof(Word)));
+                if (mask) {
+                    return i + ctz32(static_cast<std::uint32_t>(mask)) / sizeof(Word);
+                }
+            }
+            return i + find_scalar<Word>(data + i * sizeof(Word), count - i, needle);
+        }
+
+        EM_SIMD_TARGET("sse2")
+        inline std::uint32_t sum_u32_sse2(const unsigned char* data, std::size_t count) {
+            __m128i acc = _mm_setzero_si128();
+            std::size_t i = 0;
+            for (; i + 4 <= count; i += 4) {
+                acc = _mm_add_epi32(acc, _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i * 4)));
+            }
+            std::uint32_t lanes[4];
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), acc);
+            return lanes[0] + lanes[1] + lanes[2] + lanes[3] + sum_scalar<std::uint32_t>(data + i * 4, count - i);
+        }
+
+        EM_SIMD_TARGET("sse2")
+        inline std::uint64_t sum_u64_sse2(const unsigned char* data, std::size_t count) {
+            __m128i acc = _mm_setzero_si128();
+            std::size_t i = 0;
+            for (; i + 2 <= count; i += 2) {
+                acc = _mm_add_epi64(acc, _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i * 8)));
+            }
+            std::uint64_t lanes[2];
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), acc);
+            return lanes[0] + lanes[1] + sum_scalar<std::uint64_t>(data + i * 8, count - i);
+        }
+
+        EM_SIMD_TARGET("sse2")
+        inline float sum_f32_sse2(const unsigned char* data, std::size_t count) {
+            __m128 acc = _mm_setzero_ps();
+            std::size_t i = 0;
+            for (; i + 4 <= count; i += 4) {
+                acc = _mm_add_ps(acc, _mm_loadu_ps(reinterpret_cast<const float*>(data + i * 4)));
+            }
+            float lanes[4];
+            _mm_storeu_ps(lanes, acc);
+            return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]) + sum_scalar<float>(data + i * 4, count - i);
+        }
+
+        EM_SIMD_TARGET("sse2")
+        inline double sum_f64_sse2(const unsigned char* data, std::size_t count) {
+            __m128d acc = _mm_setzero_pd();
+            std::size_t i = 0;
+            for (; i + 2 <= count; i += 2) {
+                acc = _mm_add_pd(acc, _mm_loadu_pd(reinterpret_cast<const double*>(data + i * 8)));
+            }
+            double lanes[2];
+            _mm_storeu_pd(lanes, acc);
+            return lanes[0] + lanes[1] + sum_scalar<double>(data + i * 8, count - i);
+        }
+
+        // --- AVX2 ---
+
+        EM_SIMD_TARGET("avx2")
+        inline void fill_avx2(unsigned char* dst, std::size_t bytes, std::uint64_t pattern) {
+            const __m256i v = _mm256_set1_epi64x(static_cast<long long>(pattern));
+            std::size_t i = 0;
+            for (; i + 32 <= bytes; i += 32) {
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), v);
+            }
+            fill_scalar(dst + i, bytes - i, pattern);
+        }
+
+        EM_SIMD_TARGET("avx2")
+        inline void copy_avx2(unsigned char* dst, const unsigned char* src, std::size_t bytes) {
+            std::size_t i = 0;
+            for (; i + 32 <= bytes; i += 32) {
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i),
+                    _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i)));
+            }
+            copy_scalar(dst + i, src + i, bytes - i);
+        }
+
+        EM_SIMD_TARGET("avx2")
+        inline bool equal_avx2(const unsigned char* lhs, const unsigned char* rhs, std::size_t bytes) {
+            std::size_t i = 0;
+            for (; i + 32 <= bytes; i += 32) {
+                __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(lhs + i));
+                __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(rhs + i));
+                if (_mm256_movemask_epi8(_mm256_cmpeq_epi8(a, b)) != -1) {
+                    return false;
+                }
+            }
+            return equal_scalar(lhs + i, rhs + i, bytes - i);
+        }
+
+        template<typename Word>
+        EM_SIMD_TARGET("avx2")
+        std::size_t find_avx2(const unsigned char* data, std::size_t count, std::uint64_t needle) {
+            const std::size_t per_vec = 32 / sizeof(Word);
+            __m256i target;
+            switch (sizeof(Word)) {
+            case 1: target = _mm256_set1_epi8(static_cast<char>(needle)); break;
+            case 2: target = _mm256_set1_epi16(static_cast<short>(needle)); break;
+            case 4: target = _mm256_set1_epi32(static_cast<int>(needle)); break;
+            default: target = _mm256_set1_epi64x(static_cast<long long>(needle)); break;
+            }
+            std::size_t i = 0;
+            for (; i + per_vec <= count; i += per_vec) {
+                __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i * sizeof(Word)));
+                __m256i eq;
+                switch (sizeof(Word)) {
+                case 1: eq = _mm256_cmpeq_epi8(v, target); break;
+                case 2: eq = _mm256_cmpeq_epi16(v, target); break;
+                case 4: eq = _mm256_cmpeq_epi32(v, target); break;
+                default: eq = _mm256_cmpeq_epi64(v, target); break;
+                }
+                std::uint32_t mask = static_cast<std::uint32_t>(_mm256_movemask_epi8(eq));
+                if (mask) {
+                    return i + ctz32(mask) / sizeof(Word);
+                }
+            }
+            return i + find_scalar<Word>(data + i * sizeof(Word), count - i, needle);
+        }
+
+        EM_SIMD_TARGET("avx2")
+        inline std::uint32_t sum_u32_avx2(const unsigned char* data, std::size_t count) {
+            __m256i acc = _mm256_setzero_si256();
+            std::size_t i = 0;
+            for (; i + 8 <= count; i += 8) {
+                acc = _mm256_add_epi32(acc, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i * 4)));
+            }
+            std::uint32_t lanes[8];
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes), acc);
+            std::uint32_t total = 0;
+            for (std::uint32_t lane : lanes) total += lane;
+            return total + sum_scalar<std::uint32_t>(data + i * 4, count - i);
+        }
+
+        EM_SIMD_TARGET("avx2")
+        inline std::uint64_t sum_u64_avx2(const unsigned char* data, std::size_t count) {
+            __m256i acc = _mm256_setzero_si256();
+            std::size_t i = 0;
+            for (; i + 4 <= count; i += 4) {
+                acc = _mm256_add_epi64(acc, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i * 8)));
+            }
+            std::uint64_t lanes[4];
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes), acc);
+            return lanes[0] + lanes[1] + lanes[2] + lanes[3] + sum_scalar<std::uint64_t>(data + i * 8, count - i);
+        }
+
+        EM_SIMD_TARGET("avx2")
+        inline float sum_f32_avx2(const unsigned char* data, std::size_t count) {
+            __m256 acc = _mm256_setzero_ps();
+            std::size_t i = 0;
+            for (; i + 8 <= count; i += 8) {
+                acc = _mm256_add_ps(acc, _mm256_loadu_ps(reinterpret_cast<const float*>(data + i * 4)));
+            }
+            float lanes[8];
+            _mm256_storeu_ps(lanes, acc);
+            float total = ((lanes[0] + lanes[1]) + (lanes[2] + lanes[3])) + ((lanes[4] + lanes[5]) + (lanes[6] + lanes[7]));
+            return total + sum_scalar<float>(data + i * 4, count - i);
+        }
+
+        EM_SIMD_TARGET("avx2")
+        inline double sum_f64_avx2(const unsigned char* data, std::size_t count) {
+            __m256d acc = _mm256_setzero_pd();
+            std::size_t i = 0;
+            for (; i + 4 <= count; i += 4) {
+                acc = _mm256_add_pd(acc, _mm256_loadu_pd(reinterpret_cast<const double*>(data + i * 8)));
+            }
+            double lanes[4];
+            _mm256_storeu_pd(lanes, acc);
+            return ((lanes[0] + lanes[1]) + (lanes[2] + lanes[3])) + sum_scalar<double>(data + i * 8, count - i);
+        }
+
+        // --- AVX-512 (F + BW) ---
+
+        EM_SIMD_TARGET("avx512f,avx512bw")
+        inline void fill_avx512(unsigned char* dst, std::size_t bytes, std::uint64_t pattern) {
+            const __m512i v = _mm512_set1_epi64(static_cast<long long>(pattern));
+            std::size_t i = 0;
+            for (; i + 64 <= bytes; i += 64) {
+                _mm512_storeu_si512(reinterpret_cast<void*>(dst + i), v);
+            }
+            fill_scalar(dst + i, bytes - i, pattern);
+        }
+
+        EM_SIMD_TARGET("avx512f,avx512bw")
+        inline void copy_avx512(unsigned char* dst, const unsigned char* src, std::size_t bytes) {
+            std::size_t i = 0;
+            for (; i + 64 <= bytes; i += 64) {
+                _mm512_storeu_si512(reinterpret_cast<void*>(dst + i),
+                    _mm512_loadu_si512(reinterpret_cast<const void*>(src + i)));
+            }
+            copy_scalar(dst + i, src + i, bytes - i);
+        }
+
+        EM_SIMD_TARGET("avx512f,avx512bw")
+        inline bool equal_avx512(const unsigned char* lhs, const unsigned char* rhs, std::size_t bytes) {
+            std::size_t i = 0;
+            for (; i + 64 <= bytes; i += 64) {
+                __m512i a = _mm512_loadu_si512(reinterpret_cast<const void*>(lhs + i));
+                __m512i b = _mm512_loadu_si512(reinterpret_cast<const void*>(rhs + i));
+                if (_mm512_cmpneq_epi8_mask(a, b)) {
+                    return false;
+                }
+            }
+            return equal_scalar(lhs + i, rhs + i, bytes - i);
+        }
+
+        template<typename Word>
+        EM_SIMD_TARGET("avx512f,avx512bw")
+        std::size_t find_avx512(const unsigned char* data, std::size_t count, std::uint64_t needle) {
+            const std::size_t per_vec = 64 / sizeof(Word);
+            __m512i target;
+            switch (sizeof(Word)) {
+            case 1: target = _mm512_set1_epi8(static_cast<char>(needle)); break;
+            case 2: target = _mm512_set1_epi16(static_cast<short>(needle)); break;
+            case 4: target = _mm512_set1_epi32(static_cast<int>(needle)); break;
+            default: target = _mm512_set1_epi64(static_cast<long long>(needle)); break;
+            }
+            std::size_t i = 0;
+            for (; i + per_vec <= count; i += per_vec) {
+                __m512i v = _mm512_loadu_si512(reinterpret_cast<const void*>(data + i * sizeof(Word)));
+                std::uint64_t mask;
+                switch (sizeof(Word)) {
+                case 1: mask = _mm512_cmpeq_epi8_mask(v, target); break;
+                case 2: mask = _mm512_cmpeq_epi16_mask(v, target); break;
+                case 4: mask = _mm512_cmpeq_epi32_mask(v, target); break;
+                default: mask = _mm512_cmpeq_epi64_mask(v, target); break;
+                }
+                if (mask) {
+                    return i + ctz64(mask);
+                }
+            }
+            return i + find_scalar<Word>(data + i * sizeof(Word), count - i, needle);
+        }
+
+        EM_SIMD_TARGET("avx512f,avx512bw")
+        inline std::uint32_t sum_u32_avx512(const unsigned char* data, std::size_t count) {
+            __m512i acc = _mm512_setzero_si512();
+            std::size_t i = 0;
+            for (; i + 16 <= count; i += 16) {
+                acc = _mm512_add_epi32(acc, _mm512_loadu_si512(reinterpret_cast<const void*>(data + i * 4)));
+            }
+            std::uint32_t lanes[16];
+            _mm512_storeu_si512(reinterpret_cast<void*>(lanes), acc);
+            std::uint32_t total = 0;
+            for (std::uint32_t lane : lanes) total += lane;
+            return total + sum_scalar<std::uint32_t>(data + i * 4, count - i);
+        }
+
+        EM_SIMD_TARGET("avx512f,avx512bw")
+        inline std::uint64_t sum_u64_avx512(const unsigned char* data, std::size_t count) {
+            __m512i acc = _mm512_setzero_si512();
+            std::size_t i = 0;
+            for (; i + 8 <= count; i += 8) {
+                acc = _mm512_add_epi64(acc, _mm512_loadu_si512(reinterpret_cast<const void*>(data + i * 8)));
+            }
+            std::uint64_t lanes[8];
+            _mm512_storeu_si512(reinterpret_cast<void*>(lanes), acc);
+            std::uint64_t total = 0;
+            for (std::uint64_t lane : lanes) total += lane;
+            return total + sum_scalar<std::uint64_t>(data + i * 8, count - i);
+        }
+
+        EM_SIMD_TARGET("avx512f,avx512bw")
+        inline float sum_f32_avx512(const unsigned char* data, std::size_t count) {
+            __m512 acc = _mm512_setzero_ps();
+            std::size_t i = 0;
+            for (; i + 16 <= count; i += 16) {
+                acc = _mm512_add_ps(acc, _mm512_loadu_ps(reinterpret_cast<const void*>(data + i * 4)));
+            }
+            float lanes[16];
+            _mm512_storeu_ps(reinterpret_cast<void*>(lanes), acc);
+            for (std::size_t width = 8; width > 0; width /= 2) {
+                for (std::size_t lane = 0; lane < width; ++lane) lanes[lane] += lanes[lane + width];
+            }
+            return lanes[0] + sum_scalar<float>(data + i * 4, count - i);
+        }
+
+        EM_SIMD_TARGET("avx512f,avx512bw")
+        inline double sum_f64_avx512(const unsigned char* data, std::size_t count) {
+            __m512d acc = _mm512_setzero_pd();
+            std::size_t i = 0;
+            for (; i + 8 <= count; i += 8) {
+                acc = _mm512_add_pd(acc, _mm512_loadu_pd(reinterpret_cast<const void*>(data + i * 8)));
+            }
+            double lanes[8];
+            _mm512_storeu_pd(reinterpret_cast<void*>(lanes), acc);
+            for (std::size_t width = 4; width > 0; width /= 2) {
+                for (std::size_t lane = 0; lane < width; ++lane) lanes[lane] += lanes[lane + width];
+            }
+            return lanes[0] + sum_scalar<double>(data + i * 8, count - i);
+        }
+
+        inline const simd_kernels& sse2_kernels() {
+            static const simd_kernels table = {
+                &fill_sse2, &copy_sse2, &equal_sse2,
+                &find_sse2<std::uint8_t>, &find_sse2<std::uint16_t>,
+                &find_sse2<std::uint32_t>, &find_sse2<std::uint64_t>,
+                &sum_u32_sse2, &sum_u64_sse2, &sum_f32_sse2, &sum_f64_sse2
+            };
+            return table;
+        }
+
+        inline const simd_kernels& avx2_kernels() {
+            static const simd_kernels table = {
+                &fill_avx2, &copy_avx2, &equal_avx2,
+                &find_avx2<std::uint8_t>, &find_avx2<std::uint16_t>,
+                &find_avx2<std::uint32_t>, &find_avx2<std::uint64_t>,
+                &sum_u32_avx2, &sum_u64_avx2, &sum_f32_avx2, &sum_f64_avx2
+            };
+            return table;
+        }
+
+        inline const simd_kernels& avx512_kernels() {
+            static const simd_kernels table = {
+                &fill_avx512, &copy_avx512, &equal_avx512,
+                &find_avx512<std::uint8_t>, &find_avx512<std::uint16_t>,
+                &find_avx512<std::uint32_t>, &find_avx512<std::uint64_t>,
+                &sum_u32_avx512, &sum_u64_avx512, &sum_f32_avx512, &sum_f64_avx512
+            };
+            return table;
+        }
+
+        inline simd_level detect_simd_level() {
+#if defined(_MSC_VER) && !defined(__clang__)
+            int info[4];
+            __cpuid(info, 0);
+            int max_leaf = info[0];
+            __cpuid(info, 1);
+            bool sse2 = (info[3] & (1 << 26)) != 0;
+            bool os_avx = (info[2] & (1 << 27)) != 0 && (info[2] & (1 << 28)) != 0;
+            unsigned long long xcr0 = os_avx ? _xgetbv(0) : 0;
+            bool avx2 = false;
+            bool avx512 = false;
+            if (max_leaf >= 7) {
+                __cpuidex(info, 7, 0);
+                avx2 = (xcr0 & 0x6) == 0x6 && (info[1] & (1 << 5)) != 0;
+                avx512 = (xcr0 & 0xE6) == 0xE6 && (info[1] & (1 << 16)) != 0 && (info[1] & (1 << 30)) != 0;
+            }
+            if (avx512) return simd_level::avx512;
+            if (avx2) return simd_level::avx2;
+            if (sse2) return simd_level::sse2;
+            return simd_level::scalar;
+#else
+            __builtin_cpu_init();
+            if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw")) return simd_level::avx512;
+            if (__builtin_cpu_supports("avx2")) return simd_level::avx2;
+            if (__builtin_cpu_supports("sse2")) return simd_level::sse2;
+            return simd_level::scalar;
+#endif
+        }
+
+#else
+
+        inline simd_level detect_simd_level() {
+            return simd_level::scalar;
+        }
+
+#endif // EM_SIMD_X86
+
+        inline simd_level supported_simd_level() {
+            static const simd_level level = detect_simd_level();
+            return level;
+        }
+
+        inline std::atomic<int>& requested_simd_level() {
+            static std::atomic<int> level(static_cast<int>(simd_level::avx512));
+            return level;
+        }
+
+        inline const simd_kernels& active_kernels() {
+            int level = (std::min)(requested_simd_level().load(std::memory_order_relaxed),
+                static_cast<int>(supported_simd_level()));
+            switch (static_cast<simd_level>(level)) {
+#ifdef EM_SIMD_X86
+            case simd_level::avx512: return avx512_kernels();
+            case simd_level::avx2: return avx2_kernels();
+            case simd_level::sse2: return sse2_kernels();
+#endif
+            default: return scalar_kernels();
+            }
+        }
+
+        // Types whose equality is exactly equality of their object representation.
+        template<typename T>
+        struct is_bitwise_comparable : std::integral_constant<bool,
+            (std::is_integral<T>::value || std::is_enum<T>::value || std::is_pointer<T>::value) &&
+            (sizeof(T) == 1 || sizeof(T) == 2 || sizeof(T) == 4 || sizeof(T) == 8)> {};
+
+        template<typename T>
+        struct is_pattern_fillable : std::integral_constant<bool,
+            std::is_trivially_copyable<T>::value &&
+            (sizeof(T) == 1 || sizeof(T) == 2 || sizeof(T) == 4 || sizeof(T) == 8)> {};
+
+        template<typename T>
+        std::uint64_t to_bits(const T& value) {
+            std::uint64_t bits = 0;
+            std::memcpy(&bits, &value, sizeof(T));
+            return bits;
+        }
+
+        template<typename T>
+        std::uint64_t fill_pattern(const T& value) {
+            std::uint64_t pattern = 0;
+            unsigned char* out = reinterpret_cast<unsigned char*>(&pattern);
+            for (std::size_t i = 0; i < 8; i += sizeof(T)) {
+                std::memcpy(out + i, &value, sizeof(T));
+            }
+            return pattern;
+        }
+
+        template<typename T>
+        void fill_impl(T* dst, std::size_t count, const T& value, std::true_type) {
+            active_kernels().fill(reinterpret_cast<unsigned char*>(dst), count * sizeof(T), fill_pattern(value));
+        }
+
+        template<typename T>
+        void fill_impl(T* dst, std::size_t count, const T& value, std::false_type) {
+            std::fill_n(dst, count, value);
+        }
+
+        template<typename T>
+        void copy_impl(const T* src, std::size_t count, T* dst, std::true_type) {
+            active_kernels().copy(reinterpret_cast<unsigned char*>(dst), reinterpret_cast<const unsigned char*>(src), count * sizeof(T));
+        }
+
+        template<typename T>
+        void copy_impl(const T* src, std::size_t count, T* dst, std::false_type) {
+            std::copy_n(src, count, dst);
+        }
+
+        template<typename T>
+        bool equal_impl(const T* lhs, const T* rhs, std::size_t count, std::true_type) {
+            return active_kernels().equal(reinterpret_cast<const unsigned char*>(lhs), reinterpret_cast<const unsigned char*>(rhs), count * sizeof(T));
+        }
+
+        template<typename T>
+        bool equal_impl(const T* lhs, const T* rhs, std::size_t count, std::false_type) {
+            return std::equal(lhs, lhs + count, rhs);
+        }
+
+        template<typename T>
+        std::size_t find_impl(const T* data, std::size_t count, const T& value, std::true_type) {
+            const simd_kernels& k = active_kernels();
+            const unsigned char* bytes = reinterpret_cast<const unsigned char*>(data);
+            switch (sizeof(T)) {
+            case 1: return k.find8(bytes, count, to_bits(value));
+            case 2: return k.find16(bytes, count, to_bits(value));
+            case 4: return k.find32(bytes, count, to_bits(value));
+            default: return k.find64(bytes, count, to_bits(value));
+            }
+        }
+
+        template<typename T>
+        std::size_t find_impl(const T* data, std::size_t count, const T& value, std::false_type) {
+            return static_cast<std::size_t>(std::find(data, data + count, value) - data);
+        }
+
+        template<typename T, typename = void>
+        struct sum_kernel {
+            static T run(const T* data, std::size_t count) {
+                T total = T();
+                for (std::size_t i = 0; i < count; ++i) total += data[i];
+                return total;
+            }
+        };
+
+        // Integer sums wrap modulo 2^N, like the unsigned sequential sum.
+        template<typename T>
+        struct sum_kernel<T, std::enable_if_t<std::is_integral<T>::value && sizeof(T) == 4>> {
+            static T run(const T* data, std::size_t count) {
+                return static_cast<T>(active_kernels().sum_u32(reinterpret_cast<const unsigned char*>(data), count));
+            }
+        };
+
+        template<typename T>
+        struct sum_kernel<T, std::enable_if_t<std::is_integral<T>::value && sizeof(T) == 8>> {
+            static T run(const T* data, std::size_t count) {
+                return static_cast<T>(active_kernels().sum_u64(reinterpret_cast<const unsigned char*>(data), count));
+            }
+        };
+
+        template<>
+        struct sum_kernel<float> {
+            static float run(const float* data, std::size_t count) {
+                return active_kernels().sum_f32(reinterpret_cast<const unsigned char*>(data), count);
+            }
+        };
+
+        template<>
+        struct sum_kernel<double> {
+            static double run(const double* data, std::size_t count) {
+                return active_kernels().sum_f64(reinterpret_cast<const unsigned char*>(data), count);
+            }
+        };
+
+    } // namespace detail
+
+    // Highest instruction set the running CPU supports.
+    inline simd_level supported_simd_level() {
+        return detail::supported_simd_level();
+    }
+
+    // Instruction set the kernels currently use.
+    inline simd_level active_simd_level() {
+        int requested = detail::requested_simd_level().load(std::memory_order_relaxed);
+        return static_cast<simd_level>((std::min)(requested, static_cast<int>(detail::supported_simd_level())));
+    }
+
+    // Caps the kernels at `level` (never above what the CPU supports).
+    inline void set_simd_level(simd_level level) {
+        detail::requested_simd_level().store(static_cast<int>(level), std::memory_order_relaxed);
+    }
+
+    template<typename T>
+    void fill(T* dst, std::size_t count, const typename pointer<T>::value_type& value) {
+        if (!dst || count == 0) return;
+        detail::fill_impl(dst, count, value, detail::is_pattern_fillable<T>());
+    }
+
+    template<typename T>
+    void fill(const pointer<T>& dst, std::size_t count, const typename pointer<T>::value_type& value) {
+        fill(dst.get_raw_ptr(), count, value);
+    }
+
+    // Copies `count` elements from `src` to `dst`. The ranges must not overlap.
+    template<typename T>
+    void copy(const T* src, std::size_t count, T* dst) {
+        if (!src || !dst || count == 0) return;
+        detail::copy_impl(src, count, dst, std::is_trivially_copyable<T>());
+    }
+
+    template<typename T>
+    void copy(const pointer<T>& src, std::size_t count, const pointer<T>& dst) {
+        copy(static_cast<const T*>(src.get_raw_ptr()), count, dst.get_raw_ptr());
+    }
+
+    template<typename T>
+    bool equal(const T* lhs, const T* rhs, std::size_t count) {
+        if (count == 0 || lhs == rhs) return true;
+        if (!lhs || !rhs) return false;
+        return detail::equal_impl(lhs, rhs, count, detail::is_bitwise_comparable<T>());
+    }
+
+    template<typename T>
+    bool equal(const pointer<T>& lhs, const pointer<T>& rhs, std::size_t count) {
+        return equal(static_cast<const T*>(lhs.get_raw_ptr()), static_cast<const T*>(rhs.get_raw_ptr()), count);
+    }
+
+    template<typename T>
+    T sum(const T* data, std::size_t count) {
+        if (!data || count == 0) return T();
+        return detail::sum_kernel<T>::run(data, count);
+    }
+
+    template<typename T>
+    T sum(const pointer<T>& data, std::size_t count) {
+        return sum(static_cast<const T*>(data.get_raw_ptr()), count);
+    }
+
+    // Index of the first element equal to `value`, or `count` if there is none.
+    template<typename T>
+    std::size_t find(const T* data, std::size_t count, const typename pointer<T>::value_type& value) {
+        if (!data) return count;
+        return detail::find_impl(data, count, value, detail::is_bitwise_comparable<T>());
+    }
+
+    template<typename T>
+    std::size_t find(const pointer<T>& data, std::size_t count, const typename pointer<T>::value_type& value) {
+        return find(static_cast<const T*>(data.get_raw_ptr()), count, value);
+    }
+
+}
+#endif // !EM_POINTER_SIMD
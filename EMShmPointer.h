@@ -0,0 +1,215 @@
+#ifndef EM_SHM_POINTER
+#define EM_SHM_POINTER
+
+#include "EMPointer.h"
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <string>
+#include <thread>
+#include <utility>
+
+#if !defined(__unix__) && !defined(__APPLE__)
+#error "EMShmPointer.h requires POSIX shared memory (shm_open/mmap)"
+#endif
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Objects shared between processes through a named POSIX shared-memory segment.
+//
+// The segment starts with a small header holding an atomic count of attached
+// processes, followed by the object itself. Inside one process the returned
+// em::pointer<T> handles share an ordinary count; when the last of them goes
+// away the process detaches. The process that detaches last destroys the
+// object and unlinks the segment.
+//
+// T must be meaningful at any address in any process: no pointers into a
+// process heap (use em::offset_pointer or plain indices instead).
+// A process that exits without releasing its handles (crash, _exit) stays
+// counted, so the segment then outlives the workers until unlinked by hand.
+// Older glibc needs -lrt for shm_open/shm_unlink.
+
+namespace em {
+
+    namespace detail {
+
+        static_assert(ATOMIC_INT_LOCK_FREE == 2, "shm_pointer needs an address-free std::atomic<int>");
+
+        enum : std::uint32_t {
+            shm_magic = 0x454d5348u, // "EMSH"
+            shm_initialising = 0,
+            shm_ready = 1,
+            shm_failed = 2
+        };
+
+        struct shm_header {
+            std::uint32_t magic;
+            std::atomic<std::uint32_t> state;
+            std::atomic<int> attached;
+            std::uint64_t object_size;
+            std::uint64_t object_offset;
+        };
+
+        // How long attach_shm_pointer() waits for a creator to size the segment
+        // and then to construct the object.
+        constexpr std::chrono::milliseconds shm_attach_wait{ 1000 };
+
+        template<typename T>
+        std::size_t shm_object_offset() {
+            const std::size_t align = alignof(T) > alignof(shm_header) ? alignof(T) : alignof(shm_header);
+            return (sizeof(shm_header) + align - 1) / align * align;
+        }
+
+        // Drops this process's attachment. The last process out destroys the object.
+        template<typename T>
+        void shm_detach(void* base, std::size_t mapped, const std::string& name) {
+            shm_header* header = static_cast<shm_header*>(base);
+            if (header->attached.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                T* object = reinterpret_cast<T*>(static_cast<unsigned char*>(base) + header->object_offset);
+                try {
+                    object->~T();
+                }
+                catch (...) { /* Cannot throw */ }
+                ::shm_unlink(name.c_str());
+            }
+            ::munmap(base, mapped);
+        }
+
+        template<typename T>
+        pointer<T> shm_adopt(void* base, std::size_t mapped, std::string name) {
+            shm_header* header = static_cast<shm_header*>(base);
+            T* object = reinterpret_cast<T*>(static_cast<unsigned char*>(base) + header->object_offset);
+            // If the count cannot be allocated, the deleter runs at once and detaches.
+            return pointer<T>(object, [base, mapped, name](T*) { shm_detach<T>(base, mapped, name); });
+        }
+
+    } // namespace detail
+
+    // Creates the segment `name` (e.g. "/lookup-tables") and constructs T in it.
+    // Returns null if the segment already exists or cannot be set up.
+    template<typename T, typename... Args>
+    pointer<T> make_shm_pointer(const std::string& name, Args&&... args) {
+        const std::size_t offset = detail::shm_object_offset<T>();
+        const std::size_t mapped = offset + sizeof(T);
+
+        int fd = ::shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+        if (fd < 0) {
+            return pointer<T>();
+        }
+        if (::ftruncate(fd, static_cast<off_t>(mapped)) != 0) {
+            ::close(fd);
+            ::shm_unlink(name.c_str());
+            return pointer<T>();
+        }
+        void* base = ::mmap(nullptr, mapped, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (base == MAP_FAILED) {
+            ::shm_unlink(name.c_str());
+            return pointer<T>();
+        }
+
+        detail::shm_header* header = new(base) detail::shm_header;
+        header->magic = detail::shm_magic;
+        header->attached.store(1, std::memory_order_relaxed);
+        header->object_size = sizeof(T);
+        header->object_offset = offset;
+        header->state.store(detail::shm_initialising, std::memory_order_relaxed);
+
+        try {
+            new(static_cast<unsigned char*>(base) + offset) T(std::forward<Args>(args)...);
+        }
+        catch (...) {
+            header->state.store(detail::shm_failed, std::memory_order_release);
+            ::shm_unlink(name.c_str());
+            ::munmap(base, mapped);
+            return pointer<T>();
+        }
+        header->state.store(detail::shm_ready, std::memory_order_release);
+
+        return detail::shm_adopt<T>(base, mapped, name);
+    }
+
+    // Attaches to a segment created by make_shm_pointer<T>(). Waits up to
+    // detail::shm_attach_wait (1 s) for a creator that is still constructing the
+    // object. Returns null if the segment does not exist, holds a different type,
+    // is already being torn down, or its creator did not finish in time.
+    template<typename T>
+    pointer<T> attach_shm_pointer(const std::string& name) {
+        const std::size_t offset = detail::shm_object_offset<T>();
+        const std::size_t mapped = offset + sizeof(T);
+
+        int fd = ::shm_open(name.c_str(), O_RDWR, 0600);
+        if (fd < 0) {
+            return pointer<T>();
+        }
+
+        const auto deadline = std::chrono::steady_clock::now() + detail::shm_attach_wait;
+        struct stat info{};
+        bool sized = false;
+        while (::fstat(fd, &info) == 0) {
+            sized = static_cast<std::size_t>(info.st_size) >= mapped;
+            if (sized || std::chrono::steady_clock::now() >= deadline) {
+                break;
+            }
+            std::this_thread::yield();
+        }
+        if (!sized || static_cast<std::size_t>(info.st_size) != mapped) {
+            ::close(fd);
+            return pointer<T>();
+        }
+
+        void* base = ::mmap(nullptr, mapped, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (base == MAP_FAILED) {
+            return pointer<T>();
+        }
+
+        detail::shm_header* header = static_cast<detail::shm_header*>(base);
+        std::uint32_t state = header->state.load(std::memory_order_acquire);
+        // A creator that died or is stuck in the constructor never gets here.
+        while (state == detail::shm_initialising && std::chrono::steady_clock::now() < deadline) {
+            std::this_thread::yield();
+            state = header->state.load(std::memory_order_acquire);
+        }
+        if (state != detail::shm_ready || header->magic != detail::shm_magic ||
+            header->object_size != sizeof(T) || header->object_offset != offset) {
+            ::munmap(base, mapped);
+            return pointer<T>();
+        }
+
+        // Never revive a segment whose last owner is already destroying it.
+        int attached = header->attached.load(std::memory_order_relaxed);
+        do {
+            if (attached <= 0) {
+                ::munmap(base, mapped);
+                return pointer<T>();
+            }
+        } while (!header->attached.compare_exchange_weak(attached, attached + 1, std::memory_order_acq_rel, std::memory_order_relaxed));
+
+        return detail::shm_adopt<T>(base, mapped, name);
+    }
+
+    // What each worker calls: the first process creates the segment, the rest attach.
+    template<typename T, typename... Args>
+    pointer<T> open_or_make_shm_pointer(const std::string& name, Args&&... args) {
+        for (int attempt = 0; attempt < 8; ++attempt) {
+            pointer<T> attached = attach_shm_pointer<T>(name);
+            if (attached) {
+                return attached;
+            }
+            pointer<T> created = make_shm_pointer<T>(name, args...);
+            if (created) {
+                return created;
+            }
+            std::this_thread::yield();
+        }
+        return pointer<T>();
+    }
+
+}
+#endif // !EM_SHM_POINTER
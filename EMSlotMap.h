@@ -0,0 +1,405 @@
+#ifndef EM_SLOT_MAP
+#define EM_SLOT_MAP
+
+#include "EMPointer.h"
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Dense storage addressed by generational handles.
+//
+// em::slot_map<T> keeps its records contiguous and hands out em::handle<T>
+// values: a slot index plus a generation. Erasing a record bumps the slot's
+// generation, so every handle issued for it turns stale and get() returns
+// nullptr instead of another record. A 64-bit handle splits 32/32 bits; a
+// 32-bit handle uses 24 index bits and 8 generation bits, so a slot's
+// generation repeats after 255 reuses.
+//
+// Records created with emplace_shared() are owned by em::shared_handle values
+// and erased when the last one goes away. Plain handles never own anything.
+//
+// Pointers and references into the map (including em::pointers from borrow())
+// are invalidated by any insert or erase; handles are not.
+
+namespace em {
+
+    template<typename T, typename Id>
+    class handle {
+        static_assert(std::is_same<Id, std::uint32_t>::value || std::is_same<Id, std::uint64_t>::value,
+            "em::handle is either 32 or 64 bits wide");
+
+    public:
+        static constexpr unsigned index_bits = sizeof(Id) == 8 ? 32 : 24;
+        static constexpr unsigned generation_bits = sizeof(Id) * 8 - index_bits;
+        static constexpr Id index_mask = (Id(1) << index_bits) - 1;
+        static constexpr Id generation_mask = static_cast<Id>(~Id(0) >> index_bits);
+
+    private:
+        Id bits = 0;
+
+        handle(Id index, Id generation) : bits((generation << index_bits) | index) {}
+
+        template <typename U, typename I> friend class slot_map;
+
+    public:
+        handle() = default;
+
+        Id index() const {
+            return bits & index_mask;
+        }
+
+        Id generation() const {
+            return bits >> index_bits;
+        }
+
+        Id raw() const {
+            return bits;
+        }
+
+        // Generations start at 1, so the all-zero handle never names a record.
+        explicit operator bool() const {
+            return bits != 0;
+        }
+
+        bool is_null() const {
+            return bits == 0;
+        }
+
+        friend bool operator==(const handle& lhs, const handle& rhs) {
+            return lhs.bits == rhs.bits;
+        }
+
+        friend bool operator!=(const handle& lhs, const handle& rhs) {
+            return lhs.bits != rhs.bits;
+        }
+
+        friend bool operator<(const handle& lhs, const handle& rhs) {
+            return lhs.bits < rhs.bits;
+        }
+    };
+
+    // Owning handle: the record stays alive while any shared_handle to it exists.
+    // The slot_map must outlive its shared handles.
+    template<typename T, typename Id>
+    class shared_handle {
+    private:
+        slot_map<T, Id>* owner = nullptr;
+        handle<T, Id> id;
+
+        shared_handle(slot_map<T, Id>* map, handle<T, Id> h) : owner(map), id(h) {}
+
+        void release() {
+            if (owner) {
+                owner->release_ref(id);
+                owner = nullptr;
+                id = handle<T, Id>();
+            }
+        }
+
+        template <typename U, typename I> friend class slot_map;
+
+    public:
+        shared_handle() = default;
+
+        shared_handle(const shared_handle& other) : owner(other.owner), id(other.id) {
+            if (owner && !owner->add_ref(id)) {
+                owner = nullptr;
+                id = handle<T, Id>();
+            }
+        }
+
+        shared_handle(shared_handle&& other) noexcept : owner(other.owner), id(other.id) {
+            other.owner = nullptr;
+            other.id = handle<T, Id>();
+        }
+
+        ~shared_handle() {
+            release();
+        }
+
+        shared_handle& operator=(const shared_handle& other) {
+            if (this != &other) {
+                shared_handle temp(other);
+                swap(temp);
+            }
+            return *this;
+        }
+
+        shared_handle& operator=(shared_handle&& other) noexcept {
+            if (this != &other) {
+                shared_handle temp(std::move(other));
+                swap(temp);
+            }
+            return *this;
+        }
+
+        void swap(shared_handle& other) noexcept {
+            using std::swap;
+            swap(owner, other.owner);
+            swap(id, other.id);
+        }
+
+        // The plain (non-owning) handle to the same record.
+        handle<T, Id> get_handle() const {
+            return id;
+        }
+
+        T* get() const {
+            return owner ? owner->get(id) : nullptr;
+        }
+
+        T& operator*() const {
+            return *get();
+        }
+
+        T* operator->() const {
+            return get();
+        }
+
+        explicit operator bool() const {
+            return get() != nullptr;
+        }
+
+        int use_count() const {
+            return owner ? owner->use_count(id) : 0;
+        }
+    };
+
+    template<typename T, typename Id>
+    class slot_map {
+    public:
+        using handle_type = handle<T, Id>;
+        using shared_handle_type = shared_handle<T, Id>;
+        using iterator = typename std::vector<T>::iterator;
+        using const_iterator = typename std::vector<T>::const_iterator;
+
+    private:
+        static constexpr std::uint32_t no_slot = std::numeric_limits<std::uint32_t>::max();
+
+        struct slot {
+            std::uint32_t dense;       // position in `values`, or next free slot while unused
+            std::uint32_t generation;
+            std::uint32_t refs;        // shared_handle count; 0 for plainly owned records
+            bool occupied;
+        };
+
+        std::vector<T> values;
+        std::vector<std::uint32_t> dense_to_slot;
+        std::vector<slot> slots;
+        std::uint32_t free_head = no_slot;
+
+        const slot* lookup(handle_type h) const {
+            std::size_t index = static_cast<std::size_t>(h.index());
+            if (h.is_null() || index >= slots.size()) {
+                return nullptr;
+            }
+            const slot& s = slots[index];
+            return (s.occupied && s.generation == h.generation()) ? &s : nullptr;
+        }
+
+        slot* lookup(handle_type h) {
+            return const_cast<slot*>(static_cast<const slot_map*>(this)->lookup(h));
+        }
+
+        // Claims a slot for the record just appended to `values`.
+        handle_type attach_last(std::uint32_t refs) {
+            std::uint32_t index;
+            if (free_head != no_slot) {
+                index = free_head;
+                free_head = slots[index].dense;
+            }
+            else {
+                if (slots.size() > static_cast<std::size_t>(handle_type::index_mask)) {
+                    values.pop_back();
+                    return handle_type();
+                }
+                index = static_cast<std::uint32_t>(slots.size());
+                slots.push_back(slot{ 0, 1, 0, false });
+            }
+            slot& s = slots[index];
+            s.dense = static_cast<std::uint32_t>(values.size() - 1);
+            s.refs = refs;
+            s.occupied = true;
+            dense_to_slot.push_back(index);
+            return handle_type(static_cast<Id>(index), static_cast<Id>(s.generation));
+        }
+
+        void erase_slot(std::uint32_t index) {
+            slot& s = slots[index];
+            std::uint32_t hole = s.dense;
+            std::uint32_t last = static_cast<std::uint32_t>(values.size() - 1);
+            if (hole != last) {
+                values[hole] = std::move(values[last]);
+                dense_to_slot[hole] = dense_to_slot[last];
+                slots[dense_to_slot[hole]].dense = hole;
+            }
+            values.pop_back();
+            dense_to_slot.pop_back();
+
+            s.generation = (s.generation + 1) & static_cast<std::uint32_t>(handle_type::generation_mask);
+            if (s.generation == 0) {
+                s.generation = 1;
+            }
+            s.occupied = false;
+            s.refs = 0;
+            s.dense = free_head;
+            free_head = index;
+        }
+
+        bool add_ref(handle_type h) {
+            slot* s = lookup(h);
+            if (!s || s->refs == 0) {
+                return false;
+            }
+            ++s->refs;
+            return true;
+        }
+
+        void release_ref(handle_type h) {
+            slot* s = lookup(h);
+            if (s && s->refs > 0 && --s->refs == 0) {
+                erase_slot(static_cast<std::uint32_t>(h.index()));
+            }
+        }
+
+        int use_count(handle_type h) const {
+            const slot* s = lookup(h);
+            return s ? static_cast<int>(s->refs) : 0;
+        }
+
+        template <typename U, typename I> friend class shared_handle;
+
+    public:
+        slot_map() = default;
+
+        slot_map(const slot_map&) = delete;
+        slot_map& operator=(const slot_map&) = delete;
+
+        void reserve(std::size_t count) {
+            values.reserve(count);
+            dense_to_slot.reserve(count);
+            slots.reserve(count);
+        }
+
+        // Returns a null handle if the index space of the handle type is exhausted.
+        template<typename... Args>
+        handle_type emplace(Args&&... args) {
+            values.emplace_back(std::forward<Args>(args)...);
+            return attach_last(0);
+        }
+
+        handle_type insert(const T& value) {
+            return emplace(value);
+        }
+
+        handle_type insert(T&& value) {
+            return emplace(std::move(value));
+        }
+
+        // Copies the object an em::pointer refers to; null pointers give a null handle.
+        handle_type insert(const pointer<T>& value) {
+            return value ? emplace(*value) : handle_type();
+        }
+
+        template<typename... Args>
+        shared_handle_type emplace_shared(Args&&... args) {
+            values.emplace_back(std::forward<Args>(args)...);
+            handle_type h = attach_last(1);
+            return h ? shared_handle_type(this, h) : shared_handle_type();
+        }
+
+        // Another owning handle to a record created by emplace_shared(), or null.
+        shared_handle_type share(handle_type h) {
+            return add_ref(h) ? shared_handle_type(this, h) : shared_handle_type();
+        }
+
+        T* get(handle_type h) {
+            slot* s = lookup(h);
+            return s ? &values[s->dense] : nullptr;
+        }
+
+        const T* get(handle_type h) const {
+            const slot* s = lookup(h);
+            return s ? &values[s->dense] : nullptr;
+        }
+
+        // Non-owning em::pointer to the record; invalidated by the next insert or erase.
+        pointer<T> borrow(handle_type h) {
+            return em::borrow(get(h));
+        }
+
+        bool contains(handle_type h) const {
+            return lookup(h) != nullptr;
+        }
+
+        // Erases the record; all of its handles, shared ones included, turn stale.
+        bool erase(handle_type h) {
+            if (!lookup(h)) {
+                return false;
+            }
+            erase_slot(static_cast<std::uint32_t>(h.index()));
+            return true;
+        }
+
+        void clear() {
+            while (!values.empty()) {
+                erase_slot(dense_to_slot.back());
+            }
+        }
+
+        // Handle of the record at dense position `position` (for use while iterating).
+        handle_type handle_at(std::size_t position) const {
+            std::uint32_t index = dense_to_slot[position];
+            return handle_type(static_cast<Id>(index), static_cast<Id>(slots[index].generation));
+        }
+
+        std::size_t size() const {
+            return values.size();
+        }
+
+        bool empty() const {
+            return values.empty();
+        }
+
+        T* data() {
+            return values.data();
+        }
+
+        const T* data() const {
+            return values.data();
+        }
+
+        iterator begin() {
+            return values.begin();
+        }
+
+        iterator end() {
+            return values.end();
+        }
+
+        const_iterator begin() const {
+            return values.begin();
+        }
+
+        const_iterator end() const {
+            return values.end();
+        }
+    };
+
+}
+
+namespace std {
+
+    template<typename T, typename Id>
+    struct hash<em::handle<T, Id>> {
+        std::size_t operator()(const em::handle<T, Id>& h) const noexcept {
+            return std::hash<Id>()(h.raw());
+        }
+    };
+
+}
+#endif // !EM_SLOT_MAP
@@ -0,0 +1,376 @@
+#ifndef EM_TAGGED_POINTER
+#define EM_TAGGED_POINTER
+
+#include "EMPointerFwd.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <type_traits>
+#include <utility>
+
+// One-word owning pointers that carry user tag bits.
+//
+// Tag bits live in the low bits every aligned address leaves zero and,
+// optionally on x86-64, in the top 16 bits of the word (user-space addresses
+// there are 48-bit unless a process explicitly asks the kernel for more).
+// tag() numbers the low bits first, then the high ones. *, ->, [] and the
+// comparisons always use the address with the tag masked off.
+//
+// em::tagged_pointer<T, LowBits, HighBits> owns a single object like a
+// move-only em::pointer. em::tagged_shared_pointer<T, LowBits, HighBits> shares
+// ownership through a count stored next to the object, so the handle itself
+// stays one word. The tag belongs to the handle and is copied with it.
+
+namespace em {
+
+    namespace detail {
+
+#if defined(__x86_64__) || defined(_M_X64)
+        constexpr unsigned tag_max_high_bits = 16;
+#else
+        constexpr unsigned tag_max_high_bits = 0;
+#endif
+
+        constexpr bool leaves_low_bits(std::size_t alignment, unsigned bits) {
+            return alignment >= (std::size_t(1) << bits);
+        }
+
+        template<unsigned LowBits, unsigned HighBits>
+        struct tag_layout {
+            static_assert(HighBits <= tag_max_high_bits, "High tag bits are only available on x86-64 (at most 16)");
+            static_assert(sizeof(std::uintptr_t) == 8 || HighBits == 0, "High tag bits need 64-bit pointers");
+
+            static constexpr unsigned word_bits = sizeof(std::uintptr_t) * 8;
+            static constexpr std::uintptr_t low_mask = (std::uintptr_t(1) << LowBits) - 1;
+            static constexpr std::uintptr_t high_mask = HighBits == 0 ? 0 :
+                ~std::uintptr_t(0) << (HighBits == 0 ? 0 : word_bits - HighBits);
+            static constexpr std::uintptr_t tag_mask = low_mask | high_mask;
+            static constexpr std::uintptr_t max_tag = (std::uintptr_t(1) << (LowBits + HighBits)) - 1;
+
+            static std::uintptr_t pack(std::uintptr_t address, std::uintptr_t tag) {
+                std::uintptr_t low = tag & low_mask;
+                std::uintptr_t high = HighBits == 0 ? 0 : (tag >> LowBits) << (word_bits - HighBits);
+                return (address & ~tag_mask) | low | (high & high_mask);
+            }
+
+            static std::uintptr_t address(std::uintptr_t word) {
+                return word & ~tag_mask;
+            }
+
+            static std::uintptr_t tag(std::uintptr_t word) {
+                std::uintptr_t low = word & low_mask;
+                std::uintptr_t high = HighBits == 0 ? 0 : (word & high_mask) >> (word_bits - HighBits);
+                return low | (high << LowBits);
+            }
+        };
+
+        template<typename T>
+        struct tagged_shared_block {
+            std::atomic<int> count;
+            T value;
+
+            template<typename... Args>
+            explicit tagged_shared_block(Args&&... args) : count(1), value(std::forward<Args>(args)...) {}
+        };
+
+    } // namespace detail
+
+    template<typename T, unsigned LowBits, unsigned HighBits = 0, typename... Args>
+    tagged_shared_pointer<T, LowBits, HighBits> make_tagged_shared(Args&&... args);
+
+    template<typename T, unsigned LowBits, unsigned HighBits>
+    class tagged_pointer {
+        static_assert(!std::is_void<T>::value, "tagged_pointer needs a complete object type");
+        static_assert(detail::leaves_low_bits(alignof(T), LowBits), "alignof(T) does not leave that many low bits free");
+
+    private:
+        using layout = detail::tag_layout<LowBits, HighBits>;
+
+        std::uintptr_t word = 0;
+
+        T* address() const {
+            return reinterpret_cast<T*>(layout::address(word));
+        }
+
+        void delete_ptr() {
+            T* target = address();
+            word = 0;
+            delete target;
+        }
+
+    public:
+        using value_type = T;
+        using pointer_type = T*;
+        static constexpr std::uintptr_t max_tag = layout::max_tag;
+
+        tagged_pointer() = default;
+        tagged_pointer(std::nullptr_t) {}
+
+        explicit tagged_pointer(T* val, std::uintptr_t tag_value = 0) :
+            word(layout::pack(reinterpret_cast<std::uintptr_t>(val), tag_value))
+        {}
+
+        tagged_pointer(const tagged_pointer&) = delete;
+        tagged_pointer& operator=(const tagged_pointer&) = delete;
+
+        tagged_pointer(tagged_pointer&& other) noexcept : word(other.word) {
+            other.word = 0;
+        }
+
+        tagged_pointer& operator=(tagged_pointer&& other) noexcept {
+            if (this != &other) {
+                tagged_pointer temp(std::move(other));
+                swap(temp);
+            }
+            return *this;
+        }
+
+        tagged_pointer& operator=(std::nullptr_t) {
+            delete_ptr();
+            return *this;
+        }
+
+        ~tagged_pointer() {
+            delete_ptr();
+        }
+
+        T& operator*() const {
+            return *address();
+        }
+
+        T* operator->() const {
+            return address();
+        }
+
+        T& operator[](std::ptrdiff_t index) const {
+            return address()[index];
+        }
+
+        explicit operator bool() const {
+            return address() != nullptr;
+        }
+
+        T* get_raw_ptr() const {
+            return address();
+        }
+
+        bool is_null() const {
+            return address() == nullptr;
+        }
+
+        std::uintptr_t tag() const {
+            return layout::tag(word);
+        }
+
+        void set_tag(std::uintptr_t tag_value) {
+            word = layout::pack(word, tag_value);
+        }
+
+        // The packed word, address and tag together.
+        std::uintptr_t bits() const {
+            return word;
+        }
+
+        T* do_not_manage() {
+            T* released = address();
+            word = 0;
+            return released;
+        }
+
+        void swap(tagged_pointer& other) noexcept {
+            std::swap(word, other.word);
+        }
+    };
+
+    template<typename T, unsigned LowBits, unsigned HighBits>
+    class tagged_shared_pointer {
+    private:
+        using block_type = detail::tagged_shared_block<T>;
+        using layout = detail::tag_layout<LowBits, HighBits>;
+
+        static_assert(detail::leaves_low_bits(alignof(block_type), LowBits), "the shared block's alignment does not leave that many low bits free");
+
+        std::uintptr_t word = 0;
+
+        block_type* block() const {
+            return reinterpret_cast<block_type*>(layout::address(word));
+        }
+
+        void delete_ptr() {
+            block_type* target = block();
+            word = 0;
+            if (target && target->count.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                delete target;
+            }
+        }
+
+        explicit tagged_shared_pointer(block_type* adopted) : word(reinterpret_cast<std::uintptr_t>(adopted)) {}
+
+        template <typename U, unsigned L, unsigned H, typename... Args>
+        friend tagged_shared_pointer<U, L, H> make_tagged_shared(Args&&... args);
+
+    public:
+        using value_type = T;
+        using pointer_type = T*;
+        static constexpr std::uintptr_t max_tag = layout::max_tag;
+
+        tagged_shared_pointer() = default;
+        tagged_shared_pointer(std::nullptr_t) {}
+
+        tagged_shared_pointer(const tagged_shared_pointer& other) : word(other.word) {
+            if (block()) {
+                block()->count.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+
+        tagged_shared_pointer(tagged_shared_pointer&& other) noexcept : word(other.word) {
+            other.word = 0;
+        }
+
+        ~tagged_shared_pointer() {
+            delete_ptr();
+        }
+
+        tagged_shared_pointer& operator=(const tagged_shared_pointer& other) {
+            if (this != &other) {
+                tagged_shared_pointer temp(other);
+                swap(temp);
+            }
+            return *this;
+        }
+
+        tagged_shared_pointer& operator=(tagged_shared_pointer&& other) noexcept {
+            if (this != &other) {
+                tagged_shared_pointer temp(std::move(other));
+                swap(temp);
+            }
+            return *this;
+        }
+
+        tagged_shared_pointer& operator=(std::nullptr_t) {
+            delete_ptr();
+            return *this;
+        }
+
+        T& operator*() const {
+            return block()->value;
+        }
+
+        T* operator->() const {
+            return get_raw_ptr();
+        }
+
+        T& operator[](std::ptrdiff_t index) const {
+            return get_raw_ptr()[index];
+        }
+
+        explicit operator bool() const {
+            return block() != nullptr;
+        }
+
+        T* get_raw_ptr() const {
+            block_type* b = block();
+            return b ? &b->value : nullptr;
+        }
+
+        bool is_null() const {
+            return block() == nullptr;
+        }
+
+        int use_count() const {
+            block_type* b = block();
+            return b ? b->count.load(std::memory_order_acquire) : 0;
+        }
+
+        std::uintptr_t tag() const {
+            return layout::tag(word);
+        }
+
+        void set_tag(std::uintptr_t tag_value) {
+            word = layout::pack(word, tag_value);
+        }
+
+        std::uintptr_t bits() const {
+            return word;
+        }
+
+        void swap(tagged_shared_pointer& other) noexcept {
+            std::swap(word, other.word);
+        }
+    };
+
+    template<typename T, unsigned LowBits, unsigned HighBits = 0, typename... Args>
+    tagged_pointer<T, LowBits, HighBits> make_tagged(Args&&... args) {
+        return tagged_pointer<T, LowBits, HighBits>(new T(std::forward<Args>(args)...));
+    }
+
+    template<typename T, unsigned LowBits, unsigned HighBits, typename... Args>
+    tagged_shared_pointer<T, LowBits, HighBits> make_tagged_shared(Args&&... args) {
+        return tagged_shared_pointer<T, LowBits, HighBits>(new detail::tagged_shared_block<T>(std::forward<Args>(args)...));
+    }
+
+    template<typename T, unsigned L, unsigned H>
+    void swap(tagged_pointer<T, L, H>& lhs, tagged_pointer<T, L, H>& rhs) noexcept {
+        lhs.swap(rhs);
+    }
+
+    template<typename T, unsigned L, unsigned H>
+    void swap(tagged_shared_pointer<T, L, H>& lhs, tagged_shared_pointer<T, L, H>& rhs) noexcept {
+        lhs.swap(rhs);
+    }
+
+    // Comparisons look at the addresses only, never at the tags.
+
+    template<typename T, unsigned L1, unsigned H1, typename U, unsigned L2, unsigned H2>
+    bool operator==(const tagged_pointer<T, L1, H1>& lhs, const tagged_pointer<U, L2, H2>& rhs) {
+        return lhs.get_raw_ptr() == rhs.get_raw_ptr();
+    }
+
+    template<typename T, unsigned L1, unsigned H1, typename U, unsigned L2, unsigned H2>
+    bool operator!=(const tagged_pointer<T, L1, H1>& lhs, const tagged_pointer<U, L2, H2>& rhs) {
+        return !(lhs == rhs);
+    }
+
+    template<typename T, unsigned L, unsigned H>
+    bool operator<(const tagged_pointer<T, L, H>& lhs, const tagged_pointer<T, L, H>& rhs) {
+        return std::less<T*>()(lhs.get_raw_ptr(), rhs.get_raw_ptr());
+    }
+
+    template<typename T, unsigned L, unsigned H>
+    bool operator==(const tagged_pointer<T, L, H>& lhs, std::nullptr_t) {
+        return lhs.is_null();
+    }
+
+    template<typename T, unsigned L, unsigned H>
+    bool operator!=(const tagged_pointer<T, L, H>& lhs, std::nullptr_t) {
+        return !lhs.is_null();
+    }
+
+    template<typename T, unsigned L1, unsigned H1, typename U, unsigned L2, unsigned H2>
+    bool operator==(const tagged_shared_pointer<T, L1, H1>& lhs, const tagged_shared_pointer<U, L2, H2>& rhs) {
+        return lhs.get_raw_ptr() == rhs.get_raw_ptr();
+    }
+
+    template<typename T, unsigned L1, unsigned H1, typename U, unsigned L2, unsigned H2>
+    bool operator!=(const tagged_shared_pointer<T, L1, H1>& lhs, const tagged_shared_pointer<U, L2, H2>& rhs) {
+        return !(lhs == rhs);
+    }
+
+    template<typename T, unsigned L, unsigned H>
+    bool operator<(const tagged_shared_pointer<T, L, H>& lhs, const tagged_shared_pointer<T, L, H>& rhs) {
+        return std::less<T*>()(lhs.get_raw_ptr(), rhs.get_raw_ptr());
+    }
+
+    template<typename T, unsigned L, unsigned H>
+    bool operator==(const tagged_shared_pointer<T, L, H>& lhs, std::nullptr_t) {
+        return lhs.is_null();
+    }
+
+    template<typename T, unsigned L, unsigned H>
+    bool operator!=(const tagged_shared_pointer<T, L, H>& lhs, std::nullptr_t) {
+        return !lhs.is_null();
+    }
+
+}
+#endif // !EM_TAGGED_POINTER
@@ -245,14 +245,15 @@ int main() {
     // Note: Manage int via pointer<void> with appropriate deleter
     em::pointer<void> em_vptr(new int(88), [](void* vp) { std::cout << "    void* deleter for int* called." << std::endl; delete static_cast<int*>(vp); });
     if (em_vptr) {
-        // Note: Must cast using raw pointer obtained via get_raw_ptr or implicit conversion.
-        int* em_iptr_cast = static_cast<int*>(em_vptr.get_raw_ptr()); // Cast the raw void*
+        // get<T>() checks the stored type: the object was recorded as an int.
+        int* em_iptr_cast = em_vptr.get<int>();
         std::cout << "  EMPointer: Casted void* to int*: value=" << *em_iptr_cast << std::endl;
+        std::cout << "  EMPointer: get<double>() is null: " << (em_vptr.get<double>() == nullptr) << std::endl;
     }
     else {
         std::cout << "  EMPointer: Failed to create pointer<void>." << std::endl;
     }
-    std::cout << "  Note: pointer<void> requires custom deleter for meaningful RAII. Casting requires using get_raw_ptr() or implicit conversion first.\n";
+    std::cout << "  Note: pointer<void> requires custom deleter for meaningful RAII. get<T>() / cast<T>() recover the typed object.\n";
     delete static_cast<int*>(raw_vptr); // Manual cleanup for raw void*
     std::cout << "---------------------------------------------\n";
 
@@ -0,0 +1,132 @@
+// Startup cost and access latency of em::lazy_pointer.
+//
+//   startup       building N objects up front (em::pointer) against declaring
+//                 N lazy_pointers whose objects are built on first use
+//   first access  latency of the get() that runs the factory, single thread
+//                 and with several threads racing for it
+//   steady state  ns per access once built, next to em::pointer and a raw T*,
+//                 and for a lazy_pointer whose factory returned null
+//
+//     c++ -std=c++14 -O2 -pthread -I. tools/lazy_bench.cpp -o lazy_bench && ./lazy_bench
+
+#include "EMLazyPointer.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace {
+
+    using clock_type = std::chrono::steady_clock;
+
+    // Stands in for an object with real setup work (a few KB to initialise).
+    struct Table {
+        std::vector<int> rows;
+        Table() : rows(1024) {
+            for (std::size_t i = 0; i < rows.size(); ++i) rows[i] = static_cast<int>(i * 7);
+        }
+    };
+
+    volatile long sink;
+
+    double ms_since(clock_type::time_point start) {
+        return std::chrono::duration<double, std::milli>(clock_type::now() - start).count();
+    }
+
+    double percentile(std::vector<double>& samples, double p) {
+        std::sort(samples.begin(), samples.end());
+        return samples[static_cast<std::size_t>(p * (samples.size() - 1))];
+    }
+
+    // Stops the compiler from hoisting the loads out of the timing loop.
+    inline void clobber() {
+#if defined(__GNUC__)
+        __asm__ __volatile__("" ::: "memory");
+#endif
+    }
+
+    template<typename Access>
+    double ns_per_access(Access access) {
+        const long rounds = 20000000;
+        auto start = clock_type::now();
+        long total = 0;
+        for (long i = 0; i < rounds; ++i) {
+            total += access();
+            clobber();
+        }
+        sink = total;
+        return std::chrono::duration<double, std::nano>(clock_type::now() - start).count() / rounds;
+    }
+
+}
+
+int main() {
+    const std::size_t count = 10000;
+
+    {
+        auto start = clock_type::now();
+        std::vector<em::pointer<Table>> eager;
+        eager.reserve(count);
+        for (std::size_t i = 0; i < count; ++i) eager.push_back(em::pointer<Table>(new Table));
+        double eager_ms = ms_since(start);
+
+        start = clock_type::now();
+        std::vector<std::unique_ptr<em::lazy_pointer<Table>>> lazy;
+        lazy.reserve(count);
+        for (std::size_t i = 0; i < count; ++i) {
+            lazy.emplace_back(new em::lazy_pointer<Table>([] { return new Table; }));
+        }
+        double lazy_ms = ms_since(start);
+        std::printf("startup, %zu objects:     eager %8.2f ms   lazy %8.2f ms\n", count, eager_ms, lazy_ms);
+
+        std::vector<double> first;
+        first.reserve(count);
+        for (auto& p : lazy) {
+            auto t = clock_type::now();
+            sink = (*p)->rows[1];
+            first.push_back(std::chrono::duration<double, std::nano>(clock_type::now() - t).count());
+        }
+        std::printf("first access, 1 thread:     p50 %8.0f ns   p99 %8.0f ns\n", percentile(first, 0.5), percentile(first, 0.99));
+    }
+
+    {
+        const int threads = 4;
+        const int trials = 200;
+        std::vector<double> first;
+        for (int trial = 0; trial < trials; ++trial) {
+            em::lazy_pointer<Table> lazy([] { return new Table; });
+            std::atomic<bool> go{ false };
+            std::vector<double> latency(threads);
+            std::vector<std::thread> workers;
+            for (int i = 0; i < threads; ++i) {
+                workers.emplace_back([&, i] {
+                    while (!go.load(std::memory_order_acquire)) {}
+                    auto t = clock_type::now();
+                    sink = lazy->rows[1];
+                    latency[i] = std::chrono::duration<double, std::nano>(clock_type::now() - t).count();
+                });
+            }
+            go.store(true, std::memory_order_release);
+            for (auto& w : workers) w.join();
+            first.push_back(*std::max_element(latency.begin(), latency.end()));
+        }
+        std::printf("first access, %d threads:   p50 %8.0f ns   p99 %8.0f ns (slowest thread)\n", threads, percentile(first, 0.5), percentile(first, 0.99));
+    }
+
+    {
+        em::lazy_pointer<Table> lazy([] { return new Table; });
+        em::lazy_pointer<Table> empty([]() -> Table* { return nullptr; });
+        em::pointer<Table> eager(new Table);
+        Table* raw = eager.get_raw_ptr();
+        sink = lazy->rows[0] + (empty.get() ? 1 : 0);
+        std::printf("steady access:              raw %6.2f ns   em::pointer %6.2f ns   lazy %6.2f ns   lazy (null) %6.2f ns\n",
+            ns_per_access([&] { return static_cast<long>(raw->rows.size()); }),
+            ns_per_access([&] { return static_cast<long>(eager->rows.size()); }),
+            ns_per_access([&] { return static_cast<long>(lazy->rows.size()); }),
+            ns_per_access([&] { return empty.get() ? 1L : 0L; }));
+    }
+    return 0;
+}
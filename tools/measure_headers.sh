@@ -0,0 +1,73 @@
+#!/usr/bin/env bash
+# Compile cost of each EM*.h header on its own.
+#
+# For every header, compiles a translation unit that includes only that
+# header and reports the best-of-N compile time and the number of static
+# initialisers the object file carries (.init_array entries, e.g. the
+# std::ios_base::Init that <iostream> adds to every TU).
+#
+# With a git revision argument the same is measured for that revision and
+# both are printed side by side:
+#
+#     tools/measure_headers.sh            # current tree only
+#     tools/measure_headers.sh HEAD~1     # before / after
+#
+# Environment: CXX (default c++), CXXFLAGS (default "-std=c++17 -O2"),
+# RUNS (default 5).
+
+set -eu
+
+CXX=${CXX:-c++}
+CXXFLAGS=${CXXFLAGS:-"-std=c++17 -O2"}
+RUNS=${RUNS:-5}
+
+root=$(cd "$(dirname "$0")/.." && pwd)
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+
+now_ms() {
+    echo $(( $(date +%s%N) / 1000000 ))
+}
+
+# measure <include dir> <header> -> "<ms> <initialisers>", or "- -" if it does not build
+measure() {
+    local dir=$1 header=$2 tu="$work/tu.cpp" obj="$work/tu.o"
+    printf '#include "%s"\n' "$header" > "$tu"
+    if ! $CXX $CXXFLAGS -I"$dir" -c "$tu" -o "$obj" 2>/dev/null; then
+        echo "- -"
+        return
+    fi
+    local best= start elapsed i
+    for ((i = 0; i < RUNS; ++i)); do
+        start=$(now_ms)
+        $CXX $CXXFLAGS -I"$dir" -c "$tu" -o "$obj"
+        elapsed=$(( $(now_ms) - start ))
+        if [ -z "$best" ] || [ "$elapsed" -lt "$best" ]; then
+            best=$elapsed
+        fi
+    done
+    local bytes
+    bytes=$(objdump -h "$obj" | awk '$2 == ".init_array" { print $3 }')
+    echo "$best $(( 0x${bytes:-0} / 8 ))"
+}
+
+headers=$(cd "$root" && ls EM*.h)
+
+if [ $# -ge 1 ]; then
+    base="$work/base"
+    mkdir -p "$base"
+    git -C "$root" archive "$1" | tar -x -C "$base"
+    headers=$(printf '%s\n' $headers $(cd "$base" && ls EM*.h) | sort -u)
+    printf '%-26s %10s %10s %8s %8s\n' header "ms before" "ms after" "init bef" "init aft"
+    for h in $headers; do
+        read -r bms binit <<< "$(measure "$base" "$h")"
+        read -r ams ainit <<< "$(measure "$root" "$h")"
+        printf '%-26s %10s %10s %8s %8s\n' "$h" "$bms" "$ams" "$binit" "$ainit"
+    done
+else
+    printf '%-26s %10s %8s\n' header ms init
+    for h in $headers; do
+        read -r ms init <<< "$(measure "$root" "$h")"
+        printf '%-26s %10s %8s\n' "$h" "$ms" "$init"
+    done
+fi